@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_BENCH_BENCH_HELPER_H_
+#define RUBYK_BENCH_BENCH_HELPER_H_
+#include "rubyk.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Paths relative to the build directory (same as the tests).
+#define BENCH_LIB_PATH "../lib"
+#define BENCH_FIXTURES_PATH "../test/fixtures"
+
+/** Wall clock timer for benchmarks. */
+class BenchTimer
+{
+ public:
+  BenchTimer() { start(); }
+
+  void start() {
+    start_ = Profiler::now_ns();
+  }
+
+  /** Elapsed time in [ns] since start. */
+  long long elapsed_ns() const {
+    return Profiler::now_ns() - start_;
+  }
+
+  /** Elapsed time in [s] since start. */
+  double elapsed() const {
+    return elapsed_ns() / 1000000000.0;
+  }
+
+ private:
+  long long start_;
+};
+
+/** Collect timing samples and print results as JSON lines:
+ *  {"bench":"outlet_fan_out","variant":"compiled","ops":16000000,"seconds":0.41,"ops_per_sec":39024390,"p50_ns":380,"p99_ns":612}
+ */
+class BenchResult
+{
+ public:
+  BenchResult(const char *name, const char *variant) : name_(name), variant_(variant), ops_(0), seconds_(0) {
+    samples_.reserve(100000);
+  }
+
+  /** Record the duration of a single operation (or of a group of 'ops' operations). */
+  void sample(long long duration_ns, size_t ops = 1) {
+    samples_.push_back(duration_ns / (long long)ops);
+  }
+
+  /** Total operations and time used for throughput. */
+  void set_total(double ops, double seconds) {
+    ops_     = ops;
+    seconds_ = seconds;
+  }
+
+  /** Print the JSON line. */
+  void report() {
+    std::sort(samples_.begin(), samples_.end());
+    printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"ops\":%.0f,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"p50_ns\":%lld,\"p99_ns\":%lld}\n",
+           name_, variant_, ops_, seconds_, seconds_ > 0 ? ops_ / seconds_ : 0.0, percentile(0.50), percentile(0.99));
+    fflush(stdout);
+  }
+
+ private:
+  long long percentile(double p) const {
+    if (samples_.empty()) return 0;
+    size_t index = (size_t)(p * (samples_.size() - 1));
+    return samples_[index];
+  }
+
+  const char *name_;
+  const char *variant_;
+  double ops_;
+  double seconds_;
+  std::vector<long long> samples_;
+};
+
+/** Number of operations timed one by one for latency percentiles. */
+#define BENCH_SAMPLES 100000
+
+typedef void (*bench_operation_t)(void *data);
+
+/** Run 'operation' 'count' times for throughput then BENCH_SAMPLES times (at most 'count')
+ *  for latency and print the result. 'ops_per_call' is the number of messages or events
+ *  handled by a single call.
+ */
+inline void bench_run(const char *name, const char *variant, bench_operation_t operation, void *data, size_t count, double ops_per_call = 1) {
+  BenchResult result(name, variant);
+
+  BenchTimer timer;
+  for (size_t i = 0; i < count; ++i) (*operation)(data);
+  result.set_total(count * ops_per_call, timer.elapsed());
+
+  size_t samples = count < BENCH_SAMPLES ? count : BENCH_SAMPLES;
+  for (size_t i = 0; i < samples; ++i) {
+    timer.start();
+    (*operation)(data);
+    result.sample(timer.elapsed_ns());
+  }
+  result.report();
+}
+
+/** Planet with objects loaded (like ParseHelper in the tests). */
+class BenchPlanet
+{
+ public:
+  BenchPlanet() : input_(std::istringstream::in), output_(std::ostringstream::out) {
+    planet_.call(LIB_URL, Value(BENCH_LIB_PATH));
+    command_ = planet_.adopt_command(new TextCommand(input_, output_), false);
+    command_->set_silent();
+    planet_.should_run(true);
+  }
+
+  /** Parse a script (objects and links). */
+  void parse(const char *script) {
+    command_->parse(std::string(script));
+  }
+
+  Planet *planet() { return &planet_; }
+
+  TextCommand *command() { return command_; }
+
+ private:
+  Planet planet_;
+  std::istringstream input_;
+  std::ostringstream output_;
+  TextCommand *command_;
+};
+
+/** Benchmarks (one function per bench file). */
+void outlet_bench();
+void graph_bench();
+void scheduler_bench();
+void command_bench();
+
+#endif // RUBYK_BENCH_BENCH_HELPER_H_
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "bench_helper.h"
+
+#include <sstream>
+
+#define COMMAND_BENCH_LINES 100000
+#define COMMAND_BENCH_PATCH_NODES 2000
+
+struct ParseJob {
+  TextCommand *command_;
+  std::string  line_;
+};
+
+static void parse_line(void *data) {
+  ParseJob *line = (ParseJob*)data;
+  line->command_->parse(line->line_);
+}
+
+/** Load a patch where every link is written before its nodes exist (worst case for
+ *  pending links), with or without bulk loading.
+ */
+static void load_bench(bool bulk) {
+  std::ostringstream script;
+  for (size_t i = 0; i < COMMAND_BENCH_PATCH_NODES; ++i) {
+    script << "v" << i << " => v" << (i + 1) << "\n";
+  }
+  for (size_t i = 0; i <= COMMAND_BENCH_PATCH_NODES; ++i) {
+    script << "v" << i << " = Value(" << i << ")\n";
+  }
+
+  BenchPlanet bench;
+  BenchResult result("patch_load_2000", bulk ? "bulk" : "incremental");
+  BenchTimer timer;
+  if (bulk) bench.planet()->begin_bulk_load();
+  bench.parse(script.str().c_str());
+  if (bulk) bench.planet()->end_bulk_load();
+  result.sample(timer.elapsed_ns(), COMMAND_BENCH_PATCH_NODES);
+  result.set_total(COMMAND_BENCH_PATCH_NODES, timer.elapsed());
+  result.report();
+}
+
+/** TextCommand parsing and method execution rate. */
+void command_bench() {
+  BenchPlanet bench;
+  bench.parse("v = Value(1)\n");
+
+  ParseJob line;
+  line.command_ = bench.command();
+
+  line.line_ = "v/value(2.5)\n";
+  bench_run("text_command_parse", "method_call", parse_line, &line, COMMAND_BENCH_LINES);
+
+  line.line_ = "/v/value\n";
+  bench_run("text_command_parse", "url_call", parse_line, &line, COMMAND_BENCH_LINES);
+
+  load_bench(false);
+  load_bench(true);
+}
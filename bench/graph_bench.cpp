@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "bench_helper.h"
+
+#include <sstream>
+#include <vector>
+
+#define GRAPH_BENCH_MESSAGES 200000
+#define GRAPH_BENCH_DEPTH    16
+#define GRAPH_BENCH_SECONDS  2.0
+#define GRAPH_BENCH_NODES    100000
+
+static const Value sBenchValue(1.0);
+
+static void trigger_one(void *data) {
+  ((Object*)data)->trigger(sBenchValue);
+}
+
+/** Value nodes connected in a chain (real objects loaded from lib). */
+static void value_chain_bench() {
+  BenchPlanet bench;
+  std::ostringstream script;
+
+  for (size_t i = 0; i < GRAPH_BENCH_DEPTH; ++i) {
+    script << "v" << i << " = Value(1)\n";
+  }
+  for (size_t i = 0; i + 1 < GRAPH_BENCH_DEPTH; ++i) {
+    script << "v" << i << " => v" << (i + 1) << "\n";
+  }
+  bench.parse(script.str().c_str());
+
+  Object *head = bench.planet()->object_at("/v0/value");
+  if (!head) {
+    fprintf(stderr, "value_chain: could not create Value nodes (lib path '%s').\n", BENCH_LIB_PATH);
+    return;
+  }
+  bench_run("value_chain_16", "direct", trigger_one, head, GRAPH_BENCH_MESSAGES, GRAPH_BENCH_DEPTH);
+}
+
+/** Create GRAPH_BENCH_NODES Value nodes through "/class/Value/new". */
+static void create_nodes(Planet *planet, const char *variant, std::vector<Object*> *nodes) {
+  std::string class_url = std::string(CLASS_URL).append("/Value/new");
+  Value params;
+  params.set_type(HASH_VALUE);
+
+  BenchResult result("instantiate_value_100k", variant);
+  BenchTimer total;
+  BenchTimer timer;
+  for (size_t i = 0; i < GRAPH_BENCH_NODES; ++i) {
+    std::ostringstream name;
+    name << "/n" << i;
+    Value list;
+    list.push_back(name.str());
+    list.push_back(params);
+
+    timer.start();
+    Value res = planet->call(class_url, list);
+    result.sample(timer.elapsed_ns());
+    if (res.is_string()) nodes->push_back(planet->object_at(res.str()));
+  }
+  result.set_total(nodes->size(), total.elapsed());
+  result.report();
+}
+
+/** Node instantiation: first run fills the slot slabs, second run reuses freed slots. */
+static void instantiate_bench() {
+  BenchPlanet bench;
+  bench.parse("v = Value(1)\n"); // load class
+  Planet *planet = bench.planet();
+  if (!planet->object_at("/v")) {
+    fprintf(stderr, "instantiate: could not create Value nodes (lib path '%s').\n", BENCH_LIB_PATH);
+    return;
+  }
+
+  std::vector<Object*> nodes;
+  nodes.reserve(GRAPH_BENCH_NODES);
+  create_nodes(planet, "fresh", &nodes);
+
+  for (size_t i = 0; i < nodes.size(); ++i) delete nodes[i];
+  nodes.clear();
+
+  create_nodes(planet, "recycled", &nodes);
+}
+
+/** Metro at maximal tempo: events per second and tick period. */
+static void metro_bench() {
+  BenchPlanet bench;
+  // fastest tempo with a non zero period: 60000 bpm = 1 [ms] (ONE_MINUTE / tempo)
+  bench.parse("m = Metro(tempo:60000)\n");
+  Planet *planet = bench.planet();
+  WorkerStats *stats = planet->worker()->stats();
+  stats->set_enabled(true);
+
+  BenchResult result("metro_1ms", "tick");
+  BenchTimer total;
+  BenchTimer timer;
+  while (total.elapsed() < GRAPH_BENCH_SECONDS) {
+    timer.start();
+    planet->loop();
+    result.sample(timer.elapsed_ns());
+  }
+
+  // every triggered event has an entry in the lateness histogram
+  Value lateness = stats->lateness();
+  Real events = 0;
+  for (size_t i = 0; i < lateness.size(); ++i) events += lateness[i].r;
+  if (events == 0) {
+    fprintf(stderr, "metro: no event triggered (lib path '%s').\n", BENCH_LIB_PATH);
+    return;
+  }
+  result.set_total(events, total.elapsed());
+  result.report();
+}
+
+/** Value -> Lua script -> Value. */
+static void lua_bench() {
+  BenchPlanet bench;
+  std::ostringstream script;
+  script << "n = Lua('" << BENCH_FIXTURES_PATH << "/lua_test_send.lua')\n";
+  script << "v = Value()\n";
+  script << "n => v\n";
+  bench.parse(script.str().c_str());
+
+  Object *inlet = bench.planet()->object_at("/n/in/value");
+  if (!inlet) {
+    fprintf(stderr, "lua: could not load script from '%s'.\n", BENCH_FIXTURES_PATH);
+    return;
+  }
+  bench_run("lua_inlet_round_trip", "direct", trigger_one, inlet, GRAPH_BENCH_MESSAGES);
+}
+
+struct LuaCall {
+  LuaScript *script_;
+  Value      value_;
+};
+
+static void call_echo(void *data) {
+  LuaCall *call = (LuaCall*)data;
+  call->script_->call_lua("echo", call->value_);
+}
+
+/** Value -> Lua -> Value conversion cost for each type. */
+static void lua_conversion_bench() {
+  BenchPlanet bench;
+  LuaScript *script = bench.planet()->adopt(new LuaScript);
+  // all this is done by Class normally
+  script->set_name("lua");
+  script->adopt(new Object("in"));
+  script->adopt(new Object("out"));
+  Value res = script->init();
+  if (!res.is_error()) res = script->script(Value("function echo(v)\n  return v\nend"));
+  if (res.is_error()) {
+    fprintf(stderr, "lua_conversion: could not init script (%s).\n", res.to_json().c_str());
+    return;
+  }
+
+  LuaCall call;
+  call.script_ = script;
+
+  call.value_ = Value(1.5);
+  bench_run("lua_round_trip", "real", call_echo, &call, GRAPH_BENCH_MESSAGES);
+
+  call.value_ = Value("hello");
+  bench_run("lua_round_trip", "string", call_echo, &call, GRAPH_BENCH_MESSAGES);
+
+  Value list;
+  for (int i = 0; i < 16; ++i) list.push_back(Value((Real)i));
+  call.value_ = list;
+  bench_run("lua_round_trip", "list_16", call_echo, &call, GRAPH_BENCH_MESSAGES);
+}
+
+void graph_bench() {
+  value_chain_bench();
+  instantiate_bench();
+  metro_bench();
+  lua_bench();
+  lua_conversion_bench();
+}
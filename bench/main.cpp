@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "bench_helper.h"
+
+#include <cstring>
+
+struct BenchEntry {
+  const char *name;
+  void (*function)();
+};
+
+static BenchEntry sBenches[] = {
+  {"outlet",    outlet_bench},
+  {"graph",     graph_bench},
+  {"scheduler", scheduler_bench},
+  {"command",   command_bench},
+  {NULL, NULL},
+};
+
+/** Run benchmarks: build with 'make rubyk_bench' and run from the build directory.
+ *  Usage: rubyk_bench [outlet|graph|scheduler|command]...
+ *  Results are printed as JSON lines on stdout.
+ */
+int main(int argc, char *argv[]) {
+  for (BenchEntry *bench = sBenches; bench->name; ++bench) {
+    bool run = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      if (!strcmp(argv[i], bench->name)) run = true;
+    }
+    if (run) (*bench->function)();
+  }
+  return 0;
+}
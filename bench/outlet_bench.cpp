@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "bench_helper.h"
+
+#include <vector>
+
+#define OUTLET_BENCH_MESSAGES 1000000
+#define OUTLET_BENCH_WIDTH    16
+#define OUTLET_BENCH_DEPTH    16
+#define OUTLET_BENCH_HUB      500
+#define OUTLET_BENCH_HUB_OPS  200
+
+static bool sUseLinkedList = false;
+
+/** Outlet that can also send by walking its sorted connections (dispatch used before
+ *  connections were compiled).
+ */
+class BenchOutlet : public Outlet
+{
+ public:
+  BenchOutlet(Node *node) : Outlet(node, RealIO("any", "Bench output.")) {}
+
+  void send_through_list(const Value &val) {
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      ((Inlet*)connections_[i])->receive(val);
+    }
+  }
+
+  inline void bench_send(const Value &val) {
+    if (sUseLinkedList) {
+      send_through_list(val);
+    } else {
+      send(val);
+    }
+  }
+};
+
+class BenchNode : public Node
+{
+ public:
+  // slots are deleted by ~Node
+  BenchNode() : count_(0) {
+    outlet_ = new BenchOutlet(this);
+    inlet_  = new Inlet(this, receive_value, RealIO("any", "Bench input."));
+  }
+
+  static void receive_value(Inlet *inlet, const Value &val) {
+    BenchNode *node = (BenchNode*)inlet->node();
+    ++node->count_;
+    node->outlet_->bench_send(val); // forward (chain)
+  }
+
+  size_t       count_;
+  BenchOutlet *outlet_;
+  Inlet       *inlet_;
+};
+
+static const Value sBenchValue(1.0);
+
+static void send_one(void *data) {
+  ((BenchOutlet*)data)->bench_send(sBenchValue);
+}
+
+/** Many sources sending to the same inlet. */
+struct FanIn {
+  std::vector<BenchNode*> sources_;
+};
+
+static void send_fan_in(void *data) {
+  FanIn *fan_in = (FanIn*)data;
+  for (size_t i = 0; i < fan_in->sources_.size(); ++i) {
+    fan_in->sources_[i]->outlet_->bench_send(sBenchValue);
+  }
+}
+
+/** One outlet connected to N inlets. */
+static void fan_out_bench(bool linked_list) {
+  BenchNode source;
+  std::vector<BenchNode*> receivers;
+
+  for (size_t i = 0; i < OUTLET_BENCH_WIDTH; ++i) {
+    receivers.push_back(new BenchNode);
+    source.outlet_->connect(receivers.back()->inlet_);
+  }
+
+  sUseLinkedList = linked_list;
+  bench_run("outlet_fan_out_16", linked_list ? "list" : "compiled", send_one, source.outlet_, OUTLET_BENCH_MESSAGES, OUTLET_BENCH_WIDTH);
+
+  for (size_t i = 0; i < receivers.size(); ++i) delete receivers[i];
+}
+
+/** N outlets connected to the same inlet. */
+static void fan_in_bench(bool linked_list) {
+  BenchNode receiver;
+  FanIn fan_in;
+
+  for (size_t i = 0; i < OUTLET_BENCH_WIDTH; ++i) {
+    fan_in.sources_.push_back(new BenchNode);
+    fan_in.sources_.back()->outlet_->connect(receiver.inlet_);
+  }
+
+  sUseLinkedList = linked_list;
+  bench_run("outlet_fan_in_16", linked_list ? "list" : "compiled", send_fan_in, &fan_in, OUTLET_BENCH_MESSAGES / OUTLET_BENCH_WIDTH, OUTLET_BENCH_WIDTH);
+
+  for (size_t i = 0; i < fan_in.sources_.size(); ++i) delete fan_in.sources_[i];
+}
+
+/** N nodes connected in a chain. */
+static void chain_bench(bool linked_list) {
+  BenchNode source;
+  std::vector<BenchNode*> chain;
+  BenchOutlet *previous = source.outlet_;
+
+  for (size_t i = 0; i < OUTLET_BENCH_DEPTH; ++i) {
+    chain.push_back(new BenchNode);
+    previous->connect(chain.back()->inlet_);
+    previous = chain.back()->outlet_;
+  }
+
+  sUseLinkedList = linked_list;
+  bench_run("outlet_chain_16", linked_list ? "list" : "compiled", send_one, source.outlet_, OUTLET_BENCH_MESSAGES, OUTLET_BENCH_DEPTH);
+
+  for (size_t i = 0; i < chain.size(); ++i) delete chain[i];
+}
+
+/** One outlet feeding many inlets (a Metro driving a large patch). */
+struct Hub {
+  Hub() : batch_(false), round_(0) {}
+  Planet                  planet_;  /**< Owns the sort batch. */
+  BenchNode               source_;
+  std::vector<BenchNode*> receivers_;
+  bool                    batch_;
+  size_t                  round_;
+};
+
+static void connect_hub(void *data) {
+  Hub *hub = (Hub*)data;
+  for (size_t i = 0; i < hub->receivers_.size(); ++i) {
+    hub->source_.outlet_->connect(hub->receivers_[i]->inlet_);
+  }
+  for (size_t i = 0; i < hub->receivers_.size(); ++i) {
+    hub->source_.outlet_->disconnect(hub->receivers_[i]->inlet_);
+  }
+}
+
+static void move_hub_receivers(void *data) {
+  Hub *hub = (Hub*)data;
+  size_t count = hub->receivers_.size();
+  ++hub->round_;
+  if (hub->batch_) hub->planet_.sort_batch()->begin();
+  for (size_t i = 0; i < count; ++i) {
+    hub->receivers_[i]->set_trigger_position((Real)((i * 7919 + hub->round_) % count));
+  }
+  if (hub->batch_) hub->planet_.sort_batch()->end();
+}
+
+/** Connect/disconnect and reorder OUTLET_BENCH_HUB inlets on a single outlet. */
+static void hub_bench() {
+  Hub hub;
+  hub.source_.set_context(hub.planet_.worker());
+  for (size_t i = 0; i < OUTLET_BENCH_HUB; ++i) {
+    hub.receivers_.push_back(new BenchNode);
+    hub.receivers_.back()->set_context(hub.planet_.worker());
+  }
+
+  bench_run("outlet_hub_connect_500", "vector", connect_hub, &hub, OUTLET_BENCH_HUB_OPS, 2 * OUTLET_BENCH_HUB);
+
+  for (size_t i = 0; i < hub.receivers_.size(); ++i) {
+    hub.source_.outlet_->connect(hub.receivers_[i]->inlet_);
+  }
+  hub.batch_ = false;
+  bench_run("outlet_hub_reorder_500", "single", move_hub_receivers, &hub, OUTLET_BENCH_HUB_OPS, OUTLET_BENCH_HUB);
+  hub.batch_ = true;
+  bench_run("outlet_hub_reorder_500", "batch", move_hub_receivers, &hub, OUTLET_BENCH_HUB_OPS, OUTLET_BENCH_HUB);
+
+  for (size_t i = 0; i < hub.receivers_.size(); ++i) delete hub.receivers_[i];
+}
+
+void outlet_bench() {
+  fan_out_bench(true);
+  fan_out_bench(false);
+  fan_in_bench(true);
+  fan_in_bench(false);
+  chain_bench(true);
+  chain_bench(false);
+  hub_bench();
+}
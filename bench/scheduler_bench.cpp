@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "bench_helper.h"
+
+#define SCHEDULER_BENCH_EVENTS 10000
+
+class BenchReceiver : public Node
+{
+ public:
+  BenchReceiver() : count_(0) {}
+
+  virtual void bang(const Value &val) {
+    ++count_;
+  }
+
+  size_t count_;
+};
+
+/** Register events while 10k events are pending. */
+static void register_bench() {
+  BenchReceiver node; // must outlive the worker's events
+  Root root;
+  Worker worker(&root);
+  BenchResult result("scheduler_10k_pending", "register");
+  BenchTimer total;
+  BenchTimer timer;
+  worker.should_run(true);
+
+  for (size_t i = 0; i < SCHEDULER_BENCH_EVENTS; ++i) {
+    worker.register_event(new(worker.event_pool()) BangEvent(&node, worker.current_time_ + 1000 + (i * 7919) % 10000));
+  }
+
+  total.start();
+  for (size_t i = 0; i < SCHEDULER_BENCH_EVENTS; ++i) {
+    timer.start();
+    worker.register_event(new(worker.event_pool()) BangEvent(&node, worker.current_time_ + 1000 + (i * 104729) % 10000));
+    result.sample(timer.elapsed_ns());
+  }
+  result.set_total(SCHEDULER_BENCH_EVENTS, total.elapsed());
+  result.report();
+}
+
+/** Trigger 10k events in a single loop. */
+static void trigger_bench() {
+  BenchReceiver node; // must outlive the worker's events
+  Root root;
+  Worker worker(&root);
+  BenchResult result("scheduler_10k_pending", "trigger");
+  BenchTimer timer;
+  worker.should_run(true);
+
+  for (size_t i = 0; i < SCHEDULER_BENCH_EVENTS; ++i) {
+    worker.register_event(new(worker.event_pool()) BangEvent(&node, worker.current_time_ + 2));
+  }
+  Thread::millisleep(5);
+
+  timer.start();
+  worker.loop();
+  long long elapsed = timer.elapsed_ns();
+
+  if (node.count_ != SCHEDULER_BENCH_EVENTS) {
+    fprintf(stderr, "scheduler: only %lu events triggered.\n", (unsigned long)node.count_);
+  }
+  result.sample(elapsed, SCHEDULER_BENCH_EVENTS);
+  result.set_total(node.count_, elapsed / 1000000000.0);
+  result.report();
+}
+
+void scheduler_bench() {
+  register_bench();
+  trigger_bench();
+}
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_CALL_QUEUE_H_
+#define RUBYK_SRC_CORE_CALL_QUEUE_H_
+#include "oscit.h"
+
+#include <pthread.h>
+
+/** A call waiting in a CallQueue. */
+struct QueuedCall
+{
+  QueuedCall() : next_(NULL) {}
+
+  QueuedCall(const std::string &url, const Value &param) : next_(NULL) {
+    set(url, param);
+  }
+
+  /** Set target and parameter. The parameter is deep copied: reference counts are
+   *  not thread safe and the call is executed by another thread (see ValueRing).
+   */
+  void set(const std::string &url, const Value &param) {
+    url_ = url;
+    param_.copy(param);
+  }
+
+  std::string url_;            /**< Target url. */
+  Value       param_;          /**< Parameter for the call (deep copy). */
+  QueuedCall * volatile next_; /**< Next call in the queue. */
+};
+
+/** Lock-free multiple producers / single consumer queue of calls.
+ *
+ *  Command threads push calls without locking and the Worker pops them at
+ *  the beginning of each loop. Pushing is a single atomic exchange, popping
+ *  never waits on a producer (a call being pushed is simply seen on the next pop).
+ *
+ *  The queue takes ownership of pushed calls. Popped calls must be deleted by the consumer.
+ */
+class CallQueue
+{
+ public:
+  CallQueue() : head_(&stub_), tail_(&stub_) {}
+
+  ~CallQueue() {
+    QueuedCall *call;
+    while ( (call = pop()) ) delete call;
+  }
+
+  /** Add a call at the end of the queue (any thread). */
+  void push(QueuedCall *call) {
+    call->next_ = NULL;
+    __sync_synchronize();
+    QueuedCall *prev = __sync_lock_test_and_set(&head_, call);
+    // between the exchange and this line, the consumer sees the queue as empty after 'prev'
+    prev->next_ = call;
+  }
+
+  /** Get the first call in the queue or NULL if the queue is empty (consumer thread only). */
+  QueuedCall *pop() {
+    QueuedCall *tail = tail_;
+    QueuedCall *next = tail->next_;
+
+    if (tail == &stub_) {
+      if (next == NULL) return NULL; // empty
+      tail_ = next;
+      tail  = next;
+      next  = next->next_;
+    }
+
+    if (next) {
+      tail_ = next;
+      __sync_synchronize();
+      return tail;
+    }
+
+    if (tail != head_) return NULL; // a producer is not done pushing
+
+    // put back stub so that we can return the last element
+    push(&stub_);
+    next = tail->next_;
+    if (next) {
+      tail_ = next;
+      __sync_synchronize();
+      return tail;
+    }
+    return NULL;
+  }
+
+ private:
+  QueuedCall * volatile head_; /**< Last pushed call (producers side). */
+  QueuedCall *tail_;           /**< Next call to pop (consumer side). */
+  QueuedCall stub_;            /**< Dummy element so that the queue is never really empty. */
+};
+
+/** Storage for QueuedCall objects so that the consumer never allocates or deletes them.
+ *
+ *  Producers get calls from the pool (allocating only when it is empty) and the
+ *  consumer gives them back after execution. Recycling is a lock-free push. Getting
+ *  a call takes a mutex shared by the producers only: the consumer never waits on it.
+ */
+class CallPool
+{
+ public:
+  CallPool() {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+
+  ~CallPool() {
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  /** Get a call for the given url and parameter (producer threads). */
+  QueuedCall *get(const std::string &url, const Value &param) {
+    pthread_mutex_lock(&mutex_);
+      QueuedCall *call = free_calls_.pop();
+    pthread_mutex_unlock(&mutex_);
+    if (!call) call = new QueuedCall;
+    call->set(url, param);
+    return call;
+  }
+
+  /** Give back an executed call (consumer thread). The parameter is released here like
+   *  values received through a ValueRing: the consumer may have shared it.
+   */
+  void recycle(QueuedCall *call) {
+    call->param_.set_nil();
+    free_calls_.push(call);
+  }
+
+ private:
+  CallQueue       free_calls_; /**< Calls ready for reuse (pushed by the consumer, popped with mutex_). */
+  pthread_mutex_t mutex_;      /**< Serializes producers popping free_calls_. */
+};
+
+#endif // RUBYK_SRC_CORE_CALL_QUEUE_H_
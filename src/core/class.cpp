@@ -34,9 +34,10 @@
 /** Build all inlets for an object from prototypes. */
 void Class::make_inlets(Node *object)
 {
-  std::list<InletPrototype>::iterator it;
-  std::list<InletPrototype>::iterator end = inlet_prototypes_.end();
+  std::vector<InletPrototype>::iterator it;
+  std::vector<InletPrototype>::iterator end = inlet_prototypes_.end();
   Object * inlets = object->adopt(new Object("in"));
+  object->reserve_slots(inlet_prototypes_.size(), outlet_prototypes_.size());
   
   for (it = inlet_prototypes_.begin(); it != end; it++)
     inlets->adopt(new Inlet(object, *it));
@@ -45,9 +46,9 @@ void Class::make_inlets(Node *object)
 /** Build all inlets for an object from prototypes. */
 void Class::make_outlets(Node *object)
 {
-  std::list<OutletPrototype>::iterator it;
-  std::list<OutletPrototype>::iterator begin = outlet_prototypes_.begin();
-  std::list<OutletPrototype>::iterator end   = outlet_prototypes_.end();
+  std::vector<OutletPrototype>::iterator it;
+  std::vector<OutletPrototype>::iterator begin = outlet_prototypes_.begin();
+  std::vector<OutletPrototype>::iterator end   = outlet_prototypes_.end();
   Object * outlets = object->adopt(new Object("out"));
   //FIX: Object * method;
   Outlet * outlet;
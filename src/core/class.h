@@ -32,7 +32,7 @@
 #include "node.h"
 #include "planet.h"
 
-#include <list>
+#include <vector>
 
 
 /** This is a helper to prepare prototypes to:
@@ -113,6 +113,12 @@ public:
     inlet_prototypes_.push_back( InletPrototype(name, &Inlet::cast_method<R, T, Tmethod>, type) );
   }
   
+  /** Declare an inlet that can also receive whole blocks of frames (see Outlet::send_block). */
+  template <class T, void(T::*Tmethod)(const Value &val), void(T::*Tblock)(const SignalBlock &block)>
+  void add_block_inlet(const char *name, const Value &type) { 
+    inlet_prototypes_.push_back( InletPrototype(name, &Inlet::cast_method<T, Tmethod>, &Inlet::cast_block_method<T, Tblock>, type) );
+  }
+  
   /** Declare an outlet. */
   void add_outlet(const char *name, const Value &type) {
     outlet_prototypes_.push_back( OutletPrototype(name, type) );    
@@ -125,20 +131,20 @@ public:
   void make_outlets(Node *object);
   
   /** Build all methods for an object from prototypes. */
-  void make_methods(Object *object) {
-    std::list<MethodPrototype>::iterator it;
-    std::list<MethodPrototype>::iterator end = method_prototypes_.end();
+  void make_methods(Node *object) {
+    std::vector<MethodPrototype>::iterator it;
+    std::vector<MethodPrototype>::iterator end = method_prototypes_.end();
     
     for (it = method_prototypes_.begin(); it != end; it++) {
-      object->adopt(new Method(object, *it));
+      object->register_method(object->adopt(new Method(object, *it)));
     }
   }
   
 private:
   
-  std::list<InletPrototype>  inlet_prototypes_;   /**< Prototypes to create inlets. */
-  std::list<OutletPrototype> outlet_prototypes_;  /**< Prototypes to create outlets. */
-  std::list<MethodPrototype> method_prototypes_;  /**< Prototypes to create methods. */
+  std::vector<InletPrototype> inlet_prototypes_;   /**< Prototypes to create inlets. */
+  std::vector<OutletPrototype> outlet_prototypes_;  /**< Prototypes to create outlets. */
+  std::vector<MethodPrototype> method_prototypes_;  /**< Prototypes to create methods. */
 };
 
 // HELPER FOR FAST AND EASY ACCESSOR CREATION
@@ -159,5 +165,6 @@ private:
 #define ADD_SUPER_METHOD(klass, super, method, type) c->add_method<klass, super, &super::method>(#method, type);
 #define ADD_SUPER_INLET(klass,  super, method, type) c->add_inlet<klass,  super, &super::method>(#method, type);
 #define INLET(klass,  method, type) c->add_inlet<klass, &klass::method>(#method, type);
+#define BLOCK_INLET(klass, method, block_method, type) c->add_block_inlet<klass, &klass::method, &klass::block_method>(#method, type);
 #define OUTLET(klass, name,   type) c->add_outlet(#name, type);
 #endif // _CLASS_H_
\ No newline at end of file
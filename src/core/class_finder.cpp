@@ -29,7 +29,10 @@
 
 #include "class_finder.h"
 #include "planet.h"
+#include "static_object.h"
 #include <dlfcn.h> // dylib load
+#include <dirent.h> // lib path scan
+#include <unistd.h> // access
 
 
 /** This trigger implements "/class". It returns the list of objects in objects_path_. */
@@ -40,52 +43,133 @@ const Value ClassFinder::trigger (const Value &val)
 
 Object *ClassFinder::build_child(const std::string &class_name, const Value &type, Value *error) {
   Object * obj;
-  std::cout << "Trying to load " << objects_path_ << "/" << class_name << "\n";
-  // try to load dynamic lib
-  std::string path = objects_path_;
-  path.append("/").append(class_name).append(".rko");
-  if (load(path.c_str(), "init")) {
-    obj = child(class_name);
-    if ( obj != NULL ) {
-      // Found object (everything went fine) !
-      return obj;
-    } else {
-      error->set(INTERNAL_SERVER_ERROR, std::string("'").append(path).append("' should declare '").append(class_name).append("'."));
-      return NULL;
-    }
+  std::string path = class_path(class_name);
+  std::string message;
+
+  if (is_missing(class_name)) {
+    error->set(NOT_FOUND_ERROR, std::string("Could not find '").append(path).append("'."));
+    return NULL;
+  }
+
+  // compiled in (static build) or try to load dynamic lib
+  if (init_static(class_name)) {
+    // ok
+  } else if (access(path.c_str(), F_OK) != 0) {
+    // no library: do not probe again until the lib path changes
+    missing_classes_.insert(class_name);
+    error->set(NOT_FOUND_ERROR, std::string("Could not find '").append(path).append("'."));
+    return NULL;
+  } else if (!load(path.c_str(), "init", &message)) {
+    // the library exists but could not be opened (missing dependency, bad symbol): retry next time
+    fprintf(stderr, "Could not load '%s' (%s).\n", path.c_str(), message.c_str());
+    error->set(INTERNAL_SERVER_ERROR, std::string("Could not load '").append(path).append("' (").append(message).append(")."));
+    return NULL;
+  }
+
+  obj = child(class_name);
+  if ( obj != NULL ) {
+    // Found object (everything went fine) !
+    return obj;
   } else {
-    error->set(INTERNAL_SERVER_ERROR, std::string("Could not load '").append(path).append("'."));
+    error->set(INTERNAL_SERVER_ERROR, std::string("'").append(path).append("' should declare '").append(class_name).append("'."));
     return NULL;
   }
 }
 
+const Value ClassFinder::preload(const Value &val) {
+  std::vector<std::string> classes;
+  Value loaded;
+
+  missing_classes_.clear();
+
+  if (val.is_list()) {
+    // manifest
+    for (size_t i = 0; i < val.size(); ++i) {
+      if (!val[i].is_string() || find_class(val[i].str())) continue;
+      if (init_static(val[i].str())) {
+        loaded.push_back(val[i]);
+      } else {
+        classes.push_back(val[i].str());
+      }
+    }
+  } else {
+    // objects compiled in
+    std::map<std::string, object_init_t>::iterator it;
+    for (it = StaticObject::objects().begin(); it != StaticObject::objects().end(); ++it) {
+      if (!find_class(it->first) && init_static(it->first)) loaded.push_back(Value(it->first));
+    }
+
+    // all '*.rko' files in the lib path
+    DIR *dir = opendir(objects_path_.c_str());
+    if (!dir) {
+      if (!loaded.is_nil()) return loaded;
+      return Value(NOT_FOUND_ERROR, std::string("Could not open '").append(objects_path_).append("'."));
+    }
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) ) {
+      std::string file_name(entry->d_name);
+      size_t length = file_name.size();
+      if (length <= 4 || file_name.compare(length - 4, 4, ".rko") != 0) continue;
+      std::string class_name = file_name.substr(0, length - 4);
+      if (!find_class(class_name) && !StaticObject::find(class_name)) classes.push_back(class_name);
+    }
+    closedir(dir);
+  }
+
+  // dlopen is serialized by the loader lock: open the libraries one by one
+  std::string message;
+  for (size_t i = 0; i < classes.size(); ++i) {
+    const std::string &class_name = classes[i];
+    std::string path = class_path(class_name);
+    if (access(path.c_str(), F_OK) != 0) {
+      missing_classes_.insert(class_name);
+    } else if (!load(path.c_str(), "init", &message)) {
+      fprintf(stderr, "Could not preload '%s' (%s).\n", path.c_str(), message.c_str());
+    } else if (find_class(class_name)) {
+      loaded.push_back(Value(class_name));
+    } else {
+      fprintf(stderr, "'%s' should declare '%s'.\n", path.c_str(), class_name.c_str());
+    }
+  }
+  return loaded;
+}
+
+bool ClassFinder::init_static(const std::string &class_name)
+{
+  object_init_t init = StaticObject::find(class_name);
+  Planet *planet = TYPE_CAST(Planet, root_);
+  if (!init || !planet) return false;
+  (*init)(*planet);
+  return true;
+}
+
 // for help to create a portable version of this load function, read Ruby's dln.c file.
-bool ClassFinder::load(const char * file, const char * init_name)
+bool ClassFinder::load(const char * file, const char * init_name, std::string *error)
 {
   void *image;
-  void (*function)(Planet*);
-  const char *error = 0;
+  const char *message;
 
   // load shared extension image into memory
   // --->
   if ((image = (void*)dlopen(file, RTLD_LAZY|RTLD_GLOBAL)) == 0) {
-    printf("Could not open file '%s'.", file);
-    if ( (error = dlerror()) )
-      printf(" %s\n", error);
-    else
-      printf("\n");
+    *error = (message = dlerror()) ? message : "dlopen failed";
     return false;
   }
 
+  return init_image(image, file, init_name, error);
+}
+
+bool ClassFinder::init_image(void *image, const char *file, const char *init_name, std::string *error)
+{
+  void (*function)(Planet*);
+  const char *message;
+
   // get 'init' function into the image
   function = (void(*)(Planet*))dlsym(image, init_name);
   if (function == 0) {
     dlclose(image);
-    printf("Symbol '%s' not found in '%s'.",init_name,file);
-    if ( (error = dlerror()) )
-      printf(" %s\n", error);
-    else
-      printf("\n");
+    error->assign("Symbol '").append(init_name).append("' not found in '").append(file).append("'");
+    if ( (message = dlerror()) ) error->append(": ").append(message);
     return false;
   }
 
@@ -95,9 +179,9 @@ bool ClassFinder::load(const char * file, const char * init_name)
   if (planet) {
     (*function)(planet);
   } else {
-    fprintf(stderr, "Could not cast root_ to Planet* !\n");
+    error->assign("Could not cast root_ to Planet*");
     return false;
   }
 
   return true;
-}
\ No newline at end of file
+}
@@ -33,6 +33,8 @@
 #include "new_method.h"
 #include "class.h"
 
+#include <set>
+
 /** Special class to handle class listing from a directory. This usually responds at to the '/class' url. */
 class ClassFinder : public Object
 {
@@ -58,6 +60,8 @@ public:
   void init() {
     //          /class/lib
     adopt(new TMethod<ClassFinder, &ClassFinder::lib_path>(this, Url(LIB_URL).name(), StringIO("file path", "Get/set path to load objects files (*.rko).")));
+    //          /class/preload
+    adopt(new TMethod<ClassFinder, &ClassFinder::preload>(this, "preload", AnyIO("Load all classes from the lib path (or the given list of class names) before running a patch.")));
   }
 
   virtual ~ClassFinder() {}
@@ -68,10 +72,26 @@ public:
   virtual Object *build_child(const std::string &class_name, const Value &type, Value *error);
 
   const Value lib_path(const Value &val) {
-    if (val.is_string()) objects_path_ = val.str();
+    if (val.is_string()) {
+      objects_path_ = val.str();
+      missing_classes_.clear(); // new place, new chances
+    }
     return Value(objects_path_);
   }
 
+  /** Open and initialize the libraries of all the classes in the lib path (or only the
+   *  classes listed in 'val') before running a patch. Returns the list of loaded class names.
+   */
+  const Value preload(const Value &val);
+
+  /** Return true if the library of a class does not exist in the lib path (it will not
+   *  be probed again until the lib path changes). Libraries that exist but fail to load
+   *  are not cached.
+   */
+  bool is_missing(const std::string &class_name) const {
+    return missing_classes_.find(class_name) != missing_classes_.end();
+  }
+
   /** Declare a new class. This template is responsible for generating the "new" method. */
   template<class T>
   Class * declare(const char *name, const char *info, const char *options)
@@ -104,9 +124,21 @@ public:
 
 private:
   /** Load an object stored in a dynamic library. */
-  bool load(const char * file, const char * init_name);
+  bool load(const char * file, const char * init_name, std::string *error);
+
+  /** Call the init function of an object compiled in the executable (see StaticObject). */
+  bool init_static(const std::string &class_name);
+
+  /** Call the init function of an opened library. */
+  bool init_image(void *image, const char *file, const char *init_name, std::string *error);
+
+  /** Path to the library of a class. */
+  std::string class_path(const std::string &class_name) const {
+    return std::string(objects_path_).append("/").append(class_name).append(".rko");
+  }
 
-  std::string objects_path_; /**< Where to find objects in the filesystem. */
+  std::string objects_path_;               /**< Where to find objects in the filesystem. */
+  std::set<std::string> missing_classes_;  /**< Classes that could not be loaded from objects_path_. */
 };
 
 #endif // _CLASS_FINDER_H_
\ No newline at end of file
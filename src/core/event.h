@@ -30,22 +30,51 @@
 #ifndef _EVENT_H_
 #define _EVENT_H_
 #include "oscit.h"
+#include "event_pool.h"
 #include <ostream>
 
 class Node;
 class Worker;
 
+/** Value of Event::queue_index_ when the event is not in an EventQueue. */
+#define EVENT_NOT_QUEUED ((size_t)-1)
+
 /** This is the base class for Events and CallEvents. The class has a field for the time at which the event should
   * be triggered. */
 class Event
 {
  public:
-  Event (Node *node, time_t when) : when_(when), node_(node), forced_(false), parameter_(NIL_VALUE) {}
+  Event (Node *node, time_t when) : when_(when), node_(node), forced_(false), parameter_(NIL_VALUE),
+    queue_index_(EVENT_NOT_QUEUED), node_prev_(NULL), node_next_(NULL) {}
+  
+  /** Parameter is stored directly (no default construction followed by an assignment). */
+  Event (Node *node, time_t when, const Value &parameter, bool forced) : when_(when), node_(node), forced_(forced), parameter_(parameter),
+    queue_index_(EVENT_NOT_QUEUED), node_prev_(NULL), node_next_(NULL) {}
   
-  Event () : forced_(false) {}
+  Event () : forced_(false), queue_index_(EVENT_NOT_QUEUED), node_prev_(NULL), node_next_(NULL) {}
 
   virtual ~Event() {}
   
+  /** Events created with plain 'new' live on the heap. */
+  static void *operator new(size_t size) {
+    return EventPool::heap_allocate(size);
+  }
+  
+  /** Create an event in an EventPool: new(pool) BangEvent(...). */
+  static void *operator new(size_t size, EventPool *pool) {
+    return pool->allocate(size);
+  }
+  
+  /** Return memory to the pool that created the event (or to the heap). */
+  static void operator delete(void *ptr) {
+    EventPool::release(ptr);
+  }
+  
+  /** Used if the constructor throws. */
+  static void operator delete(void *ptr, EventPool *pool) {
+    EventPool::release(ptr);
+  }
+  
   void trigger() {
     (*function_)(node_,parameter_);
   }
@@ -64,9 +93,15 @@ class Event
     forced_ = forced;
   }
   
+  /** Copy the event into another pool (used when a node moves to another worker). */
+  virtual Event *clone(EventPool *pool) const {
+    return (new(pool) Event(*this))->unqueued();
+  }
+  
 protected:
   friend class Worker; // TODO: remove these
   friend class Node;   // TODO: remove these
+  friend class EventQueue;
   
   time_t when_;
   Node * node_;
@@ -74,25 +109,37 @@ protected:
   Value  parameter_;
   
   void (*function_)(Node *receiver, const Value &parameter);
+
+  /** Clear queue information copied from another event. */
+  Event *unqueued() {
+    queue_index_ = EVENT_NOT_QUEUED;
+    node_prev_   = NULL;
+    node_next_   = NULL;
+    return this;
+  }
+
+private:
+  size_t             queue_index_; /**< Position in the EventQueue heap (EVENT_NOT_QUEUED if not queued). */
+  unsigned long long sequence_;    /**< Insertion order (keeps events with the same time ordered). */
+  Event *node_prev_;               /**< Previous event queued for the same node. */
+  Event *node_next_;               /**< Next event queued for the same node. */
 };
 
 /** This is an event that sends a bang to a node. */
 class BangEvent : public Event
 {
 public:
-  BangEvent(Node *receiver, time_t when, bool forced = false) {
-    when_      = when;
-    node_  = receiver;
+  BangEvent(Node *receiver, time_t when, bool forced = false) : Event(receiver, when, gNilValue, forced) {
     function_  = &cast_bang_method;
-    forced_    = forced;
   }
   
-  BangEvent(Node *receiver, time_t when, const Value &parameter, bool forced = false) {
-    when_      = when;
-    node_  = receiver;
+  /** The parameter is shared (Values are reference counted): no deep copy. */
+  BangEvent(Node *receiver, time_t when, const Value &parameter, bool forced = false) : Event(receiver, when, parameter, forced) {
     function_  = &cast_bang_method;
-    parameter_ = parameter;
-    forced_    = forced;
+  }
+  
+  virtual Event *clone(EventPool *pool) const {
+    return (new(pool) BangEvent(*this))->unqueued();
   }
   
 private:
@@ -104,13 +151,15 @@ template<class T, void(T::*Tmethod)(const Value&)>
 class TEvent : public Event
 {
 public:
-  TEvent (time_t when, T *node, const Value &parameter)
+  TEvent (time_t when, T *node, const Value &parameter, bool forced = false) : Event(node, when, parameter, forced)
   {
-    when_      = when;
-    node_      = node;
-    parameter_ = parameter;
     function_  = &cast_method;
   }
+  
+  virtual Event *clone(EventPool *pool) const {
+    return (new(pool) TEvent(*this))->unqueued();
+  }
+  
 private:
   /** Make pointer to method for events. */
   static void cast_method(Node *node, const Value &parameter) {
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "event_pool.h"
+
+#include <new> // std::bad_alloc
+
+#define EVENT_POOL_STRIDE (sizeof(Header) + EVENT_POOL_BLOCK_SIZE)
+
+EventPool::~EventPool() {
+  std::vector<void*>::iterator it, end = chunks_.end();
+  for (it = chunks_.begin(); it != end; ++it) {
+    free(*it);
+  }
+}
+
+void *EventPool::allocate(size_t size) {
+  if (size > EVENT_POOL_BLOCK_SIZE) {
+    ++heap_allocations_;
+    return heap_allocate(size);
+  }
+
+  if (!free_list_) grow(capacity_ ? capacity_ : EVENT_POOL_CHUNK_SIZE);
+
+  Header *header = free_list_;
+  free_list_ = header->next;
+  header->pool = this;
+
+  if (++in_use_ > high_water_mark_) high_water_mark_ = in_use_;
+  return (void*)(header + 1);
+}
+
+void EventPool::reserve(size_t count) {
+  if (capacity_ - in_use_ < count) grow(count - (capacity_ - in_use_));
+}
+
+void *EventPool::heap_allocate(size_t size) {
+  Header *header = (Header*)malloc(sizeof(Header) + size);
+  if (!header) throw std::bad_alloc();
+  header->pool = NULL;
+  return (void*)(header + 1);
+}
+
+void EventPool::release(void *ptr) {
+  if (!ptr) return;
+  Header *header = ((Header*)ptr) - 1;
+  if (header->pool) {
+    header->pool->release_block(header);
+  } else {
+    free(header);
+  }
+}
+
+void EventPool::release_block(Header *header) {
+  header->next = free_list_;
+  free_list_ = header;
+  --in_use_;
+}
+
+void EventPool::grow(size_t count) {
+  char *chunk = (char*)malloc(count * EVENT_POOL_STRIDE);
+  if (!chunk) throw std::bad_alloc();
+  chunks_.push_back(chunk);
+
+  for (size_t i = 0; i < count; ++i) {
+    Header *header = (Header*)(chunk + i * EVENT_POOL_STRIDE);
+    header->next = free_list_;
+    free_list_ = header;
+  }
+  capacity_ += count;
+}
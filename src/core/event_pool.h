@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_EVENT_POOL_H_
+#define RUBYK_SRC_CORE_EVENT_POOL_H_
+
+#include <cstdlib>
+#include <vector>
+
+/** Number of event blocks allocated at once when the pool is empty. */
+#define EVENT_POOL_CHUNK_SIZE 256
+/** Size of the storage available for an event in the pool. Larger objects use the heap. */
+#define EVENT_POOL_BLOCK_SIZE 128
+
+/** Fixed size allocator for Events.
+ *
+ *  Every event is prefixed by a small header pointing to the pool that
+ *  allocated it (or NULL for events created with plain 'new'). This way
+ *  'delete event' always works and returns the memory to the right place.
+ *
+ *  Freed blocks are kept in an intrusive free list. Once the pool has grown
+ *  to the number of simultaneous events, scheduling does not touch the heap anymore.
+ *
+ *  The pool is not thread safe: it must be used with the worker lock.
+ */
+class EventPool
+{
+ public:
+  EventPool() : free_list_(NULL), in_use_(0), high_water_mark_(0), capacity_(0), heap_allocations_(0) {}
+
+  ~EventPool();
+
+  /** Get storage for an event of the given size. */
+  void *allocate(size_t size);
+
+  /** Make sure there are at least 'count' free blocks in the pool. */
+  void reserve(size_t count);
+
+  /** Allocate storage for an event outside any pool. */
+  static void *heap_allocate(size_t size);
+
+  /** Release event storage (from a pool or from the heap). */
+  static void release(void *ptr);
+
+  /** Number of blocks currently used by events. */
+  size_t in_use() const { return in_use_; }
+
+  /** Maximal number of blocks used at the same time. */
+  size_t high_water_mark() const { return high_water_mark_; }
+
+  /** Total number of blocks owned by the pool. */
+  size_t capacity() const { return capacity_; }
+
+  /** Number of events that were too large for the pool and used the heap. */
+  size_t heap_allocations() const { return heap_allocations_; }
+
+ private:
+  /** Header placed before every event. */
+  union Header {
+    EventPool *pool;  /**< Owner (NULL = heap). */
+    Header    *next;  /**< Next free block (when in the free list). */
+    double     align; /**< Make sure the event that follows is properly aligned. */
+    void      *align_ptr;
+  };
+
+  /** Allocate a new chunk of blocks and add them to the free list. */
+  void grow(size_t count);
+
+  void release_block(Header *header);
+
+  Header *free_list_;          /**< Intrusive list of free blocks. */
+  std::vector<void*> chunks_;  /**< Memory chunks owned by the pool. */
+  size_t in_use_;
+  size_t high_water_mark_;
+  size_t capacity_;
+  size_t heap_allocations_;
+};
+
+#endif // RUBYK_SRC_CORE_EVENT_POOL_H_
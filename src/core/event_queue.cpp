@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "event_queue.h"
+#include "node.h"
+
+#define EVENT_QUEUE_ARITY 4
+
+void EventQueue::push(Event *event) {
+  if (event->queue_index_ != EVENT_NOT_QUEUED) return;
+
+  event->sequence_ = sequence_++;
+  heap_.push_back(event);
+  place(heap_.size() - 1, event);
+  sift_up(heap_.size() - 1);
+
+  // link in node's event list
+  Node *node = event->node_;
+  if (node) {
+    event->node_prev_ = NULL;
+    event->node_next_ = node->events_;
+    if (node->events_) node->events_->node_prev_ = event;
+    node->events_ = event;
+  }
+}
+
+bool EventQueue::remove(Event *event) {
+  size_t index = event->queue_index_;
+  if (index == EVENT_NOT_QUEUED || index >= heap_.size() || heap_[index] != event) return false;
+
+  Event *last = heap_.back();
+  heap_.pop_back();
+  event->queue_index_ = EVENT_NOT_QUEUED;
+
+  if (last != event) {
+    place(index, last);
+    if (index > 0 && before(last, heap_[(index - 1) / EVENT_QUEUE_ARITY])) {
+      sift_up(index);
+    } else {
+      sift_down(index);
+    }
+  }
+
+  // unlink from node's event list
+  Node *node = event->node_;
+  if (node) {
+    if (event->node_prev_) {
+      event->node_prev_->node_next_ = event->node_next_;
+    } else {
+      node->events_ = event->node_next_;
+    }
+    if (event->node_next_) event->node_next_->node_prev_ = event->node_prev_;
+  }
+  event->node_prev_ = NULL;
+  event->node_next_ = NULL;
+  return true;
+}
+
+Event *EventQueue::first_event_for(const Node *node) const {
+  return node->events_;
+}
+
+void EventQueue::sift_up(size_t index) {
+  Event *event = heap_[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / EVENT_QUEUE_ARITY;
+    if (!before(event, heap_[parent])) break;
+    place(index, heap_[parent]);
+    index = parent;
+  }
+  place(index, event);
+}
+
+void EventQueue::sift_down(size_t index) {
+  size_t size = heap_.size();
+  Event *event = heap_[index];
+  while (true) {
+    size_t first_child = index * EVENT_QUEUE_ARITY + 1;
+    if (first_child >= size) break;
+
+    // find earliest child
+    size_t best = first_child;
+    size_t end  = first_child + EVENT_QUEUE_ARITY;
+    if (end > size) end = size;
+    for (size_t child = first_child + 1; child < end; ++child) {
+      if (before(heap_[child], heap_[best])) best = child;
+    }
+
+    if (!before(heap_[best], event)) break;
+    place(index, heap_[best]);
+    index = best;
+  }
+  place(index, event);
+}
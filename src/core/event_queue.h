@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_EVENT_QUEUE_H_
+#define RUBYK_SRC_CORE_EVENT_QUEUE_H_
+#include "event.h"
+
+#include <vector>
+
+/** Priority queue for timed events (4-ary heap).
+ *
+ *  Events with the same trigger time are kept in insertion order. Every queued
+ *  event knows its position in the heap so that it can be removed in O(log n)
+ *  without searching. Events are also linked in a per-node list so that all the
+ *  events of a given node can be found without scanning the whole queue.
+ *
+ *  The queue does not own the events: the Worker is responsible for deleting them.
+ */
+class EventQueue
+{
+ public:
+  EventQueue() : sequence_(0) {}
+
+  bool empty() const { return heap_.empty(); }
+
+  size_t size() const { return heap_.size(); }
+
+  /** Return the earliest event (queue must not be empty). */
+  Event *front() const { return heap_.front(); }
+
+  /** Get the earliest event. Return false if the queue is empty. */
+  bool get(Event **event) const {
+    if (heap_.empty()) return false;
+    *event = heap_.front();
+    return true;
+  }
+
+  /** Insert an event. Nothing is done if the event is already queued. */
+  void push(Event *event);
+
+  /** Remove the earliest event. */
+  void pop() {
+    if (!heap_.empty()) remove(heap_.front());
+  }
+
+  /** Remove an event from the queue. Return false if the event was not queued. */
+  bool remove(Event *event);
+
+  /** Return one of the events queued for the given node or NULL if there are none. */
+  Event *first_event_for(const Node *node) const;
+
+ private:
+  /** Return true if event 'a' should be triggered before event 'b'. */
+  inline bool before(const Event *a, const Event *b) const {
+    return a->when_ < b->when_ || (a->when_ == b->when_ && a->sequence_ < b->sequence_);
+  }
+
+  /** Store event at the given position in the heap. */
+  inline void place(size_t index, Event *event) {
+    heap_[index] = event;
+    event->queue_index_ = index;
+  }
+
+  void sift_up(size_t index);
+
+  void sift_down(size_t index);
+
+  std::vector<Event*> heap_;     /**< 4-ary heap, earliest event on top. */
+  unsigned long long  sequence_; /**< Insertion counter used to keep events with the same time in order. */
+};
+
+#endif // RUBYK_SRC_CORE_EVENT_QUEUE_H_
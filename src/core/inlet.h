@@ -30,20 +30,25 @@
 #ifndef RUBYK_SRC_CORE_INLET_H_
 #define RUBYK_SRC_CORE_INLET_H_
 #include "slot.h"
+#include "signal_block.h"
 
 class Inlet;
 class Node;
 
 typedef void(*inlet_method_t)(Inlet *node, const Value &val);
+typedef void(*inlet_block_method_t)(Inlet *node, const SignalBlock &block);
 
 /** Prototype constructor for Inlets. */
 struct InletPrototype
 {
-  InletPrototype(const char *name, inlet_method_t method, const Value &type) : name_(name), method_(method), type_(type) {}
+  InletPrototype(const char *name, inlet_method_t method, const Value &type) : name_(name), method_(method), block_method_(NULL), type_(type) {}
   
-  std::string    name_;
-  inlet_method_t method_;
-  Value          type_;
+  InletPrototype(const char *name, inlet_method_t method, inlet_block_method_t block_method, const Value &type) : name_(name), method_(method), block_method_(block_method), type_(type) {}
+  
+  std::string          name_;
+  inlet_method_t       method_;
+  inlet_block_method_t block_method_;
+  Value                type_;
 };
 
 class Inlet : public Slot {
@@ -51,22 +56,31 @@ public:
   TYPED("Object.Slot.Inlet")
   
   /** Constructor used for testing. */
-  Inlet(Node *node, inlet_method_t method, const Value &type) : Slot(node, type), method_(method) {
+  Inlet(Node *node, inlet_method_t method, const Value &type) : Slot(node, type), method_(method), block_method_(NULL) {
     register_in_node();
   }
   
-  Inlet(Node *node, const char *name, inlet_method_t method, const Value &type) : Slot(node, name, type), method_(method) {
+  Inlet(Node *node, const char *name, inlet_method_t method, const Value &type) : Slot(node, name, type), method_(method), block_method_(NULL) {
     register_in_node();
   }
   
   /** Prototype based constructor. */
-  Inlet(Node *node, const InletPrototype &prototype) : Slot(node, prototype.name_, prototype.type_), method_(prototype.method_) {
+  Inlet(Node *node, const InletPrototype &prototype) : Slot(node, prototype.name_, prototype.type_), method_(prototype.method_), block_method_(prototype.block_method_) {
     register_in_node();
   }
   
   virtual ~Inlet() {
     unregister_in_node();
   }
+
+  /** Inlets are allocated from a slab: a patch creates many of them with the same size. */
+  static void *operator new(size_t size) {
+    return SlabAllocator<Inlet>::allocate(size);
+  }
+
+  static void operator delete(void *ptr, size_t size) {
+    SlabAllocator<Inlet>::release(ptr, size);
+  }
   
   /** Inform the node about the existence of this outlet (direct callback). */
   void register_in_node();
@@ -82,6 +96,31 @@ public:
     (*method_)(this, val);     // use functor
   }
   
+  /** Receive a block of frames. Without a block method, each frame is received
+   *  in order as a normal value.
+   */
+  inline void receive_block(const SignalBlock &block) {
+    if (block_method_) {
+      (*block_method_)(this, block);
+    } else {
+      for (size_t i = 0; i < block.frames_; ++i) (*method_)(this, block.frame_value(i));
+    }
+  }
+  
+  /** Method called on receive (used by outlets to compile connections). */
+  inline inlet_method_t method() const { return method_; }
+  
+  /** Set the method receiving whole blocks (NULL = receive frame by frame). */
+  void set_block_method(inlet_block_method_t block_method) {
+    block_method_ = block_method;
+  }
+  
+  /** Create a callback receiving blocks. */
+  template <class T, void(T::*Tmethod)(const SignalBlock &block)>
+  static void cast_block_method(Inlet *inlet, const SignalBlock &block) {
+    (((T*)inlet->node_)->*Tmethod)(block);
+  }
+  
   /** Create a callback for an inlet. */
   template <class T, void(T::*Tmethod)(const Value &val)>
   static void cast_method(Inlet *inlet, const Value &val) {
@@ -108,7 +147,8 @@ public:
     // ignore return value
   }
 private:
-  inlet_method_t method_;        /**< Method to set a new value. */
+  inlet_method_t method_;              /**< Method to set a new value. */
+  inlet_block_method_t block_method_;  /**< Method receiving a block of frames (can be NULL). */
 };
 
 #endif // RUBYK_SRC_CORE_INLET_H_
\ No newline at end of file
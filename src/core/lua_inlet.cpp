@@ -27,13 +27,35 @@
   ==============================================================================
 */
 
+extern "C" {
+// we compiled Lua as C code
+#include <lua.h>
+#include <lauxlib.h>
+}
+
 #include "lua_inlet.h"
 #include "lua_script.h"
 
 
 LuaInlet::LuaInlet(LuaScript *node, const char *name, const Value &type) :
-    Inlet(static_cast<Node*>(node), name, &LuaInlet::receive_method, type) {}
+    Inlet(static_cast<Node*>(node), name, &LuaInlet::receive_method, type), key_ref_(LUA_NOREF) {}
 
 void LuaInlet::receive_method(Inlet *inlet, const Value &val) {
-  ((LuaScript*)inlet->node())->call_lua(inlet->name().c_str(), val);
-}
\ No newline at end of file
+  ((LuaScript*)inlet->node())->call_inlet((LuaInlet*)inlet, val);
+}
+
+void LuaInlet::release_key(lua_State *L) {
+  luaL_unref(L, LUA_REGISTRYINDEX, key_ref_);
+  key_ref_ = LUA_NOREF;
+}
+
+void LuaInlet::push_function(lua_State *L) {
+  if (key_ref_ == LUA_NOREF) {
+    lua_pushstring(L, name_.c_str());
+    key_ref_ = luaL_ref(L, LUA_REGISTRYINDEX); // pops name
+  }
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, key_ref_);
+  lua_gettable(L, -2);                                // env, function
+  lua_remove(L, -2);                                  // function
+}
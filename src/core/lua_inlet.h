@@ -32,12 +32,28 @@
 #include "inlet.h"
 
 class LuaScript;
+struct lua_State;
 
 class LuaInlet : public Inlet {
 public:
+  TYPED("Object.Slot.Inlet.LuaInlet")
+
   LuaInlet(LuaScript *node, const char *name, const Value &type);
 
   static void receive_method(Inlet *inlet, const Value &val);
+
+  /** Free the registry reference to the inlet's name (the lua_State outlives the inlet).
+   */
+  void release_key(lua_State *L);
+
+  /** Push the inlet's function from the environment table on top of the stack.
+   *  The global is read on every call (the script can reassign it) with the inlet's
+   *  name interned once in the registry.
+   */
+  void push_function(lua_State *L);
+
+private:
+  int key_ref_;      /**< Registry reference to the inlet's name (interned Lua string). */
 };
 
 #endif // RUBYK_SRC_CORE_LUA_INLET_H_
\ No newline at end of file
@@ -36,20 +36,35 @@ extern "C" {
 
 #include "lua_script.h"
 #include "lua_inlet.h"
+#include "lua_vm.h"
 
 #define RUBYK_THIS_IN_LUA "__this"
 #define LUA_OUTLET_NAME   "Outlet"
 
 const Value LuaScript::lua_init() {
-  // Our own lua context.
-  lua_ = lua_open();
+  if (LuaVM::shared()) {
+    // Interpreter shared with the other nodes of the worker.
+    vm_  = LuaVM::acquire(worker_);
+    lua_ = vm_->state();
+  } else {
+    // Our own lua context.
+    lua_ = lua_open();
+    
+    // Load Lua main libraries
+    luaL_openlibs(lua_);
+  }
+  LuaVMLock lock(vm_);
   
-  // Load Lua main libraries
-  luaL_openlibs(lua_);
+  if (vm_) {
+    env_ref_ = vm_->new_environment();
+  } else {
+    lua_pushvalue(lua_, LUA_GLOBALSINDEX);
+    env_ref_ = luaL_ref(lua_, LUA_REGISTRYINDEX);
+  }
   
-  // push 'this' into the global field '__this'
+  // push 'this' into the global field '__this' (C methods use an upvalue)
   lua_pushlightuserdata(lua_, (void*)this);
-  lua_setglobal(lua_, "__this");
+  set_global(RUBYK_THIS_IN_LUA);
   
   register_lua_method<LuaScript, &LuaScript::lua_inlet>("inlet");
   // TODO: make sure build_outlet_ and send_ are never accessible from lua (only through Outlet).
@@ -63,77 +78,154 @@ const Value LuaScript::lua_init() {
   } else {
     std::string path(res.str());
     path.append("/lua/rubyk.lua");
-    int status = luaL_dofile(lua_, path.c_str());
+    // compiled once, then loaded from bytecode
+    int status = LuaVM::load_cached_file(lua_, path);
+    if (!status) {
+      push_env();
+      lua_setfenv(lua_, -2);
+      status = lua_pcall(lua_, 0, 0, 0);
+    }
     if (status) {
-      return Value(INTERNAL_SERVER_ERROR, 
-        std::string(lua_tostring(lua_, -1)).append("."));
+      Value error(INTERNAL_SERVER_ERROR, std::string(lua_tostring(lua_, -1)).append("."));
+      lua_pop(lua_, 1);
+      return error;
     }
   }
   return gNilValue;
 }
 
 LuaScript::~LuaScript() {
-  lua_close(lua_);
+  if (!lua_) return;
+  if (vm_) {
+    {
+      LuaVMLock lock(vm_);
+      // the VM lives on: free our registry entries
+      const std::vector<Inlet*> &list = inlets();
+      for (size_t i = 0; i < list.size(); ++i) {
+        LuaInlet *inlet = TYPE_CAST(LuaInlet, list[i]);
+        if (inlet) inlet->release_key(lua_);
+      }
+      luaL_unref(lua_, LUA_REGISTRYINDEX, env_ref_);
+    }
+    LuaVM::release(vm_);
+  } else {
+    lua_close(lua_);
+  }
+}
+
+void LuaScript::push_env() {
+  lua_rawgeti(lua_, LUA_REGISTRYINDEX, env_ref_);
+}
+
+void LuaScript::get_global(const char *name) {
+  push_env();
+  lua_getfield(lua_, -1, name);
+  lua_remove(lua_, -2); // env
+}
+
+void LuaScript::set_global(const char *name) {
+  push_env();
+  lua_insert(lua_, -2);         // env, value
+  lua_setfield(lua_, -2, name); // pops value
+  lua_pop(lua_, 1);             // env
+}
+
+bool LuaScript::prepare_call() {
+  if (worker_->current_time_ != lua_current_time_) {
+    // many messages arrive during the same time slice: check file and set globals once
+    reload_script(worker_->current_time_);
+
+    lua_current_time_ = worker_->current_time_;
+    lua_pushnumber(lua_, lua_current_time_);
+    set_global("current_time");
+  }
+  return is_ok();
 }
 
 const Value LuaScript::call_lua(const char *function_name, const Value &val) {
-  int status;
+  LuaVMLock lock(vm_);
+  if (!prepare_call()) return Value(BAD_REQUEST_ERROR, "Script is broken.");
 
-  reload_script(worker_->current_time_);
+  get_global(function_name); /* function to be called */
+  return pcall_top(function_name, val, true);
+}
 
-  if (!is_ok()) return Value(BAD_REQUEST_ERROR, "Script is broken.");
+const Value LuaScript::call_inlet(LuaInlet *inlet, const Value &val) {
+  LuaVMLock lock(vm_);
+  if (!prepare_call()) return Value(BAD_REQUEST_ERROR, "Script is broken.");
 
-  lua_pushnumber(lua_, worker_->current_time_);
-  lua_setglobal(lua_, "current_time");
+  push_env();
+  inlet->push_function(lua_);
+  return pcall_top(inlet->name().c_str(), val, false);
+}
+
+const Value LuaScript::pcall_top(const char *function_name, const Value &val, bool results) {
+  int status;
 
-  lua_getglobal(lua_, function_name); /* function to be called */
   if (!lua_pushvalue(lua_, val)) {
     return Value(BAD_REQUEST_ERROR, std::string("cannot call '").append(function_name).append("' with argument ").append(val.lazy_json()).append(" (type not yet suported in Lua).\n"));
   }
   
   /* Run the function. */
-  status = lua_pcall(lua_, 1, 1, 0); // 1 arg, 1 result, no error function
+  status = lua_pcall(lua_, 1, results ? 1 : 0, 0); // 1 arg, 1 or 0 result, no error function
   if (status) {
-    return Value(BAD_REQUEST_ERROR, lua_tostring(lua_, -1));
+    Value error(BAD_REQUEST_ERROR, lua_tostring(lua_, -1));
+    lua_settop(lua_, 0);
+    return error;
   }
   
+  if (!results) {
+    // inlet call: nothing to convert back
+    lua_settop(lua_, 0);
+    return gNilValue;
+  }
   return stack_to_value(lua_);
 }
 
 
 const Value LuaScript::eval_script() {
   int status;
+  LuaVMLock lock(vm_);
   
   /* set 'current_time' */
-  lua_pushnumber(lua_, worker_->current_time_);
-  lua_setglobal(lua_, "current_time");
+  lua_current_time_ = worker_->current_time_;
+  lua_pushnumber(lua_, lua_current_time_);
+  set_global("current_time");
   
-  // compile script
-  status = luaL_loadbuffer(lua_, script_.c_str(), script_.size(), name_.c_str());
+  // compile script (or load bytecode from the cache)
+  status = LuaVM::load_script(lua_, script_, name_.c_str());
   if (status) {
-    return Value(BAD_REQUEST_ERROR, std::string(lua_tostring(lua_, -1)).append("."));
+    Value error(BAD_REQUEST_ERROR, std::string(lua_tostring(lua_, -1)).append("."));
+    lua_pop(lua_, 1);
+    return error;
   }
   
+  // globals defined by the script go to the node's environment
+  push_env();
+  lua_setfenv(lua_, -2);
+  
   // Run the script to create the functions.
   status = lua_pcall(lua_, 0, 0, 0); // 0 arg, 1 result, no error function
   if (status) {
     // TODO: proper error reporting
-      return Value(BAD_REQUEST_ERROR, std::string(lua_tostring(lua_, -1)).append("."));
+    Value error(BAD_REQUEST_ERROR, std::string(lua_tostring(lua_, -1)).append("."));
+    lua_pop(lua_, 1);
+    return error;
   }
   // ok, we can receive and process values (again).
   return Value(script_);
 }
 
 void LuaScript::register_lua_method(const char *name, lua_CFunction function) {
-  lua_pushcfunction(lua_, function);
-  lua_setglobal(lua_, name);
+  // 'this' as upvalue: no global lookup on each call
+  lua_pushlightuserdata(lua_, (void*)this);
+  lua_pushcclosure(lua_, function, 1);
+  set_global(name);
 }
 
 LuaScript *LuaScript::lua_this(lua_State *L) {
-  lua_getglobal(L, RUBYK_THIS_IN_LUA);
-  LuaScript *script = (LuaScript*)lua_touserdata(L,lua_gettop(L));
-  if (!script) fprintf(stderr, "Lua error: '__this' not set.\n");
-  lua_pop(L,1);
+  LuaScript *script = (LuaScript*)lua_touserdata(L, lua_upvalueindex(1));
+  if (!script) fprintf(stderr, "Lua error: 'this' not set.\n");
   return script;
 }
 
@@ -236,9 +328,13 @@ bool LuaScript::value_from_lua(lua_State *L, int index, Value *res) {
     res->set((Real)lua_toboolean(L, index));
     break;
   case LUA_TTABLE:
-    // list or midi message ?
-    lua_pushstring(L, "type");
-    lua_gettable(L, index);
+    if (lua_objlen(L, index) > 0) {
+      // array: no need to look for a 'type' field
+      res->set_empty();
+      return list_from_lua(L, index, res);
+    }
+    // empty list or midi message ?
+    lua_getfield(L, index, "type");
     if (lua_isstring(L, -1)) {
       lua_pop(L,1); // type
       // midi
@@ -269,7 +365,10 @@ bool LuaScript::list_from_lua(lua_State *L, int index, Value *val) {
     
     lua_rawgeti(L, index, i); // no meta table passing
     
-    if (!value_from_lua(L, -1, &tmp)) {
+    if (lua_type(L, -1) == LUA_TNUMBER) {
+      // fast path for numeric arrays
+      val->push_back(Value(lua_tonumber(L, -1)));
+    } else if (!value_from_lua(L, -1, &tmp)) {
       // TODO: unsupported format. BAD
       val->push_back(gNilValue);
     } else {
@@ -323,14 +422,18 @@ bool LuaScript::lua_pushvalue(lua_State *L, const Value &val) {
 
 
 bool LuaScript::lua_pushlist(lua_State *L, const Value &val) {
-  lua_createtable(L, val.size(), 0); // top
+  size_t size = val.size();
+  lua_createtable(L, size, 0); // top
   
-  for (size_t i = 0; i < val.size(); ++i) {
-    lua_pushnumber(L, i + 1);
-    if (!lua_pushvalue(L, val[i])) {
+  for (size_t i = 0; i < size; ++i) {
+    const Value &item = val[i];
+    if (item.is_real()) {
+      // fast path for numeric arrays
+      lua_pushnumber(L, item.r);
+    } else if (!lua_pushvalue(L, item)) {
       return false;
     }
-    lua_settable(L, -3); // stack = ..., {}, i, VALUE
+    lua_rawseti(L, -2, i + 1); // stack = ..., {}, VALUE
   }
   return true;
 }
@@ -34,11 +34,15 @@
 #include "node.h"
 
 class Outlet;
+class LuaInlet;
+class LuaVM;
 struct lua_State;
 typedef int (*lua_CFunction) (lua_State *L);
 
 class LuaScript : public Node, public Script {
 public:
+  LuaScript() : lua_(NULL), vm_(NULL), env_ref_(-1), lua_current_time_(-1) {}
+  
   virtual const Value init() {
     return lua_init();
   }
@@ -48,6 +52,11 @@ public:
   /** Call a function in lua.
    */
   const Value call_lua(const char *function_name, const Value &val);
+  
+  /** Call the function registered for an inlet (no global lookup). Values
+   *  returned by the function are dropped: returns nil or an error.
+   */
+  const Value call_inlet(LuaInlet *inlet, const Value &val);
 protected:
   /** Initialization (build methods, load libraries, etc).
    */
@@ -69,6 +78,8 @@ protected:
    */
   int lua_build_outlet(const Value &val);
   
+  /** 'this' is stored as the first upvalue of all registered methods.
+   */
   template <class T, int (T::*Tmethod)(const Value &)>
   static int cast_method_for_lua(lua_State *L) {
     T *node = (T*)lua_this(L);
@@ -93,6 +104,28 @@ protected:
 private:
   static LuaScript *lua_this(lua_State *L);
   
+  /** Check for script reload and update 'current_time' once per worker time
+   *  change (not on every message). Returns false if the script is broken.
+   */
+  bool prepare_call();
+  
+  /** Call the function on top of the stack with 'val' as argument. The
+   *  results are converted only if 'results' is true.
+   */
+  const Value pcall_top(const char *function_name, const Value &val, bool results);
+  
+  /** Push the node's environment table (the globals table if the VM is not shared).
+   */
+  void push_env();
+  
+  /** Push a global from the node's environment.
+   */
+  void get_global(const char *name);
+  
+  /** Pop the value on top of the stack into a global of the node's environment.
+   */
+  void set_global(const char *name);
+  
   /** Pop all the stack as a list value.
    */
   static const Value stack_to_value(lua_State *L, int start_index = 1);
@@ -140,6 +173,18 @@ private:
   /** Every script has its own lua environment.
    */
   lua_State * lua_;
+  
+  /** Shared interpreter (NULL if the node has its own lua_State).
+   */
+  LuaVM *vm_;
+  
+  /** Registry reference to the node's environment table.
+   */
+  int env_ref_;
+  
+  /** Value of the 'current_time' global in lua.
+   */
+  time_t lua_current_time_;
 };
 
 #endif // RUBYK_SRC_CORE_LUA_SCRIPT_H_
\ No newline at end of file
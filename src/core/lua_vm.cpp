@@ -0,0 +1,430 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+extern "C" {
+// we compiled Lua as C code
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#ifdef RUBYK_USE_LUAJIT
+#include <luajit.h>
+#endif
+}
+
+#include "lua_vm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <set>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>  // getpid
+#include <utime.h>
+
+// Bytecode is only valid for the interpreter that produced it.
+#ifdef RUBYK_USE_LUAJIT
+#define LUA_CACHE_VERSION LUAJIT_VERSION
+#else
+#define LUA_CACHE_VERSION LUA_RELEASE
+#endif
+
+// Header of cached bytecode files: magic, interpreter version, '\0', source hash
+// and source length (16 hex digits each), '\0'. The bytecode follows.
+#define LUA_CACHE_MAGIC "RKLC"
+
+bool LuaVM::sShared = false;
+
+pthread_mutex_t LuaVM::sPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+std::string LuaVM::sCachePath;
+
+size_t LuaVM::sCacheHits = 0;
+
+bool LuaVM::sCacheRunning = false;
+
+pthread_t LuaVM::sCacheThread;
+
+pthread_mutex_t LuaVM::sCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+pthread_cond_t LuaVM::sCacheCond = PTHREAD_COND_INITIALIZER;
+
+pthread_mutex_t LuaVM::sCacheControlMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Shared VMs by key. */
+static std::map<const void*, LuaVM*> &vm_pool() {
+  static std::map<const void*, LuaVM*> pool;
+  return pool;
+}
+
+/** Compiled files by path. */
+static std::map<std::string, std::string> &bytecode_cache() {
+  static std::map<std::string, std::string> cache;
+  return cache;
+}
+
+/** Cache files (header and bytecode) loaded or compiled in this process, by
+ *  path. Protected by sCacheMutex.
+ */
+static std::map<std::string, std::string> &script_cache() {
+  static std::map<std::string, std::string> cache;
+  return cache;
+}
+
+/** Files for the cache thread to write (path, content). Protected by sCacheMutex. */
+static std::list<std::pair<std::string, std::string> > &cache_writes() {
+  static std::list<std::pair<std::string, std::string> > writes;
+  return writes;
+}
+
+/** Files for the cache thread to mark as recently used. Protected by sCacheMutex. */
+static std::set<std::string> &cache_touches() {
+  static std::set<std::string> touches;
+  return touches;
+}
+
+static int write_bytecode(lua_State *L, const void *data, size_t size, void *buffer) {
+  ((std::string*)buffer)->append((const char*)data, size);
+  return 0;
+}
+
+/** FNV-1a hash (64 bit). */
+static unsigned long long fnv1a(const char *data, size_t size, unsigned long long hash = 14695981039346656037ULL) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/** djb2 hash (64 bit). Stored in the file header: a different function than the
+ *  one used for file names so that a collision of one does not load the bytecode
+ *  of another script.
+ */
+static unsigned long long djb2(const char *data, size_t size) {
+  unsigned long long hash = 5381;
+  for (size_t i = 0; i < size; ++i) {
+    hash = hash * 33 + (unsigned char)data[i];
+  }
+  return hash;
+}
+
+/** Read a file if it starts with the given header. The rest of the file is only
+ *  read when the header matches.
+ */
+static bool read_file(const std::string &path, const std::string &header, std::string *content) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+  content->resize(header.size());
+  if (fread(&(*content)[0], 1, header.size(), file) != header.size() || *content != header) {
+    fclose(file);
+    content->clear();
+    return false;
+  }
+  char buffer[4096];
+  size_t count;
+  while ( (count = fread(buffer, 1, sizeof(buffer), file)) > 0 ) {
+    content->append(buffer, count);
+  }
+  fclose(file);
+  return true;
+}
+
+/** Write to a temporary file and rename so that readers never see a partial file. */
+static void write_file(const std::string &path, const std::string &content) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+  std::string tmp_path(path);
+  tmp_path.append(suffix);
+
+  FILE *file = fopen(tmp_path.c_str(), "wb");
+  if (!file) return;
+  bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+  }
+}
+
+/** Remove the least recently used scripts when the cache holds more than
+ *  LUA_CACHE_MAX_FILES of them (each edit of a script adds a file). Called
+ *  once by the cache thread when it starts.
+ */
+static void prune_cache(const std::string &dir) {
+  DIR *directory = opendir(dir.c_str());
+  if (!directory) return;
+  std::vector<std::pair<time_t, std::string> > files;
+  struct dirent *entry;
+  struct stat info;
+  while ( (entry = readdir(directory)) ) {
+    std::string name(entry->d_name);
+    if (name.size() < 5 || name.compare(name.size() - 5, 5, ".luac") != 0) continue;
+    std::string path(dir);
+    path.append("/").append(name);
+    if (stat(path.c_str(), &info) == 0) files.push_back(std::make_pair(info.st_mtime, path));
+  }
+  closedir(directory);
+
+  if (files.size() <= LUA_CACHE_MAX_FILES) return;
+  std::sort(files.begin(), files.end()); // oldest first
+  for (size_t i = 0; i < files.size() - LUA_CACHE_MAX_FILES; ++i) {
+    unlink(files[i].second.c_str());
+  }
+}
+
+bool LuaVM::shared() {
+  pthread_mutex_lock(&sPoolMutex);
+    bool shared = sShared;
+  pthread_mutex_unlock(&sPoolMutex);
+  return shared;
+}
+
+void LuaVM::set_shared(bool shared) {
+  pthread_mutex_lock(&sPoolMutex);
+    sShared = shared;
+  pthread_mutex_unlock(&sPoolMutex);
+}
+
+LuaVM *LuaVM::acquire(const void *key) {
+  LuaVM *vm;
+  pthread_mutex_lock(&sPoolMutex);
+    std::map<const void*, LuaVM*>::iterator it = vm_pool().find(key);
+    if (it == vm_pool().end()) {
+      vm = new LuaVM(key);
+      vm_pool()[key] = vm;
+    } else {
+      vm = it->second;
+    }
+    ++vm->refs_;
+  pthread_mutex_unlock(&sPoolMutex);
+  return vm;
+}
+
+void LuaVM::release(LuaVM *vm) {
+  pthread_mutex_lock(&sPoolMutex);
+    if (--vm->refs_ == 0) {
+      vm_pool().erase(vm->key_);
+      delete vm;
+    }
+  pthread_mutex_unlock(&sPoolMutex);
+}
+
+size_t LuaVM::count() {
+  pthread_mutex_lock(&sPoolMutex);
+    size_t count = vm_pool().size();
+  pthread_mutex_unlock(&sPoolMutex);
+  return count;
+}
+
+int LuaVM::load_cached_file(lua_State *L, const std::string &path) {
+  int status;
+  pthread_mutex_lock(&sPoolMutex);
+    std::map<std::string, std::string>::iterator it = bytecode_cache().find(path);
+    if (it != bytecode_cache().end()) {
+      status = luaL_loadbuffer(L, it->second.data(), it->second.size(), path.c_str());
+    } else {
+      status = luaL_loadfile(L, path.c_str());
+      if (!status) {
+        std::string bytecode;
+        if (lua_dump(L, write_bytecode, &bytecode) == 0) {
+          bytecode_cache()[path] = bytecode;
+        }
+      }
+    }
+  pthread_mutex_unlock(&sPoolMutex);
+  return status;
+}
+
+std::string LuaVM::cache_path() {
+  // copy under the lock: scripts are loaded from worker threads
+  pthread_mutex_lock(&sCacheMutex);
+    std::string path(sCachePath.data(), sCachePath.size());
+  pthread_mutex_unlock(&sCacheMutex);
+  return path;
+}
+
+void LuaVM::set_cache_path(const std::string &path) {
+  pthread_mutex_lock(&sCacheControlMutex);
+    // stop the thread of the previous directory (it finishes pending writes)
+    pthread_mutex_lock(&sCacheMutex);
+      bool running = sCacheRunning;
+      sCacheRunning = false;
+      pthread_cond_signal(&sCacheCond);
+    pthread_mutex_unlock(&sCacheMutex);
+    if (running) pthread_join(sCacheThread, NULL);
+
+    pthread_mutex_lock(&sCacheMutex);
+      sCachePath.assign(path.data(), path.size());
+      // loaded scripts belong to the previous directory
+      script_cache().clear();
+      cache_touches().clear();
+      if (!path.empty()) {
+        sCacheRunning = true;
+        if (pthread_create(&sCacheThread, NULL, cache_thread, NULL)) {
+          fprintf(stderr, "Could not start Lua cache thread (scripts will not be cached).\n");
+          sCacheRunning = false;
+          sCachePath.clear();
+        }
+      }
+    pthread_mutex_unlock(&sCacheMutex);
+  pthread_mutex_unlock(&sCacheControlMutex);
+}
+
+void *LuaVM::cache_thread(void *data) {
+  std::string dir(cache_path());
+  prune_cache(dir);
+
+  std::list<std::pair<std::string, std::string> > writes;
+  std::set<std::string> touches;
+  pthread_mutex_lock(&sCacheMutex);
+    while (true) {
+      while (sCacheRunning && cache_writes().empty() && cache_touches().empty()) {
+        pthread_cond_wait(&sCacheCond, &sCacheMutex);
+      }
+      if (cache_writes().empty() && cache_touches().empty()) break; // stopped
+      writes.swap(cache_writes());
+      touches.swap(cache_touches());
+      pthread_mutex_unlock(&sCacheMutex);
+
+        for (std::list<std::pair<std::string, std::string> >::iterator it = writes.begin(); it != writes.end(); ++it) {
+          write_file(it->first, it->second);
+        }
+        for (std::set<std::string>::iterator it = touches.begin(); it != touches.end(); ++it) {
+          utime(it->c_str(), NULL); // recently used (see prune_cache)
+        }
+        writes.clear();
+        touches.clear();
+
+      pthread_mutex_lock(&sCacheMutex);
+    }
+  pthread_mutex_unlock(&sCacheMutex);
+  return NULL;
+}
+
+int LuaVM::load_script(lua_State *L, const std::string &source, const char *name) {
+  std::string cache_dir(cache_path());
+  if (cache_dir.empty()) {
+    return luaL_loadbuffer(L, source.data(), source.size(), name);
+  }
+
+  // the chunk name is part of the bytecode (error messages)
+  unsigned long long hash = fnv1a(source.data(), source.size());
+  hash = fnv1a(name, strlen(name), hash);
+  char file_name[32];
+  snprintf(file_name, sizeof(file_name), "/%016llx.luac", hash);
+  std::string path(cache_dir);
+  path.append(file_name);
+
+  // fixed size header: checked before the bytecode is read
+  std::string header(LUA_CACHE_MAGIC LUA_CACHE_VERSION);
+  header.push_back('\0');
+  char check[40];
+  snprintf(check, sizeof(check), "%016llx%016llx", djb2(source.data(), source.size()), (unsigned long long)source.size());
+  header.append(check);
+  header.push_back('\0');
+
+  std::string cached;
+  pthread_mutex_lock(&sCacheMutex);
+    std::map<std::string, std::string>::iterator it = script_cache().find(path);
+    bool in_memory = it != script_cache().end() && it->second.compare(0, header.size(), header) == 0;
+    if (in_memory) cached = it->second;
+  pthread_mutex_unlock(&sCacheMutex);
+
+  // Only the first load of a script in the process reads the directory.
+  if ((in_memory || read_file(path, header, &cached)) && cached.size() > header.size()) {
+    if (luaL_loadbuffer(L, cached.data() + header.size(), cached.size() - header.size(), name) == 0) {
+      pthread_mutex_lock(&sCacheMutex);
+        ++sCacheHits;
+        if (!in_memory) {
+          if (script_cache().size() >= LUA_CACHE_MAX_FILES) script_cache().clear();
+          script_cache()[path] = cached;
+        }
+        cache_touches().insert(path);
+        pthread_cond_signal(&sCacheCond);
+      pthread_mutex_unlock(&sCacheMutex);
+      return 0;
+    }
+    lua_pop(L, 1); // bad bytecode: compile from source
+  }
+
+  int status = luaL_loadbuffer(L, source.data(), source.size(), name);
+  if (status) return status;
+
+  std::string bytecode(header);
+  if (lua_dump(L, write_bytecode, &bytecode) == 0) {
+    pthread_mutex_lock(&sCacheMutex);
+      // the directory could have changed while we compiled
+      if (sCacheRunning && sCachePath == cache_dir) {
+        if (script_cache().size() >= LUA_CACHE_MAX_FILES) script_cache().clear();
+        script_cache()[path] = bytecode;
+        cache_writes().push_back(std::make_pair(path, bytecode));
+        pthread_cond_signal(&sCacheCond);
+      }
+    pthread_mutex_unlock(&sCacheMutex);
+  }
+  return 0;
+}
+
+size_t LuaVM::cache_hits() {
+  pthread_mutex_lock(&sCacheMutex);
+    size_t hits = sCacheHits;
+  pthread_mutex_unlock(&sCacheMutex);
+  return hits;
+}
+
+LuaVM::LuaVM(const void *key) : key_(key), refs_(0) {
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // lua -> outlet -> lua
+  pthread_mutex_init(&mutex_, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  lua_ = lua_open();
+  luaL_openlibs(lua_);
+
+  // metatable for node environments
+  lua_createtable(lua_, 0, 1);
+  lua_pushvalue(lua_, LUA_GLOBALSINDEX);
+  lua_setfield(lua_, -2, "__index");
+  env_meta_ref_ = luaL_ref(lua_, LUA_REGISTRYINDEX);
+}
+
+LuaVM::~LuaVM() {
+  lua_close(lua_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+int LuaVM::new_environment() {
+  lua_newtable(lua_);
+  lua_rawgeti(lua_, LUA_REGISTRYINDEX, env_meta_ref_);
+  lua_setmetatable(lua_, -2);
+  return luaL_ref(lua_, LUA_REGISTRYINDEX);
+}
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_LUA_VM_H_
+#define RUBYK_SRC_CORE_LUA_VM_H_
+
+#include <map>
+#include <string>
+#include <pthread.h>
+
+struct lua_State;
+
+// Maximal number of compiled scripts kept in the cache directory.
+#define LUA_CACHE_MAX_FILES 512
+
+/** Lua interpreter shared by the LuaScript nodes of a worker.
+ *
+ *  The standard libraries are opened once. Each node runs in its own
+ *  environment table (see setfenv) so node globals do not collide. Shared
+ *  VMs are only used when LuaVM::set_shared(true) was called before the
+ *  nodes are created.
+ */
+class LuaVM
+{
+ public:
+  /** True if new Lua nodes should use a shared VM. Like the cache path, this
+   *  setting is process-wide (all planets) and can be read from any thread.
+   */
+  static bool shared();
+
+  static void set_shared(bool shared);
+
+  /** Get (or create) the VM for the given key (worker). */
+  static LuaVM *acquire(const void *key);
+
+  /** Release a VM obtained with acquire. The VM is closed with its last node. */
+  static void release(LuaVM *vm);
+
+  /** Number of open shared VMs. */
+  static size_t count();
+
+  /** Load a lua file and push the compiled chunk. The bytecode is compiled
+   *  once and kept for later loads (rubyk.lua for example). Returns the
+   *  lua status (0 = ok, error message on the stack otherwise).
+   */
+  static int load_cached_file(lua_State *L, const std::string &path);
+
+  /** Compile a script and push the chunk. If a cache directory is set, the
+   *  bytecode is stored there under a hash of the source and reused as long
+   *  as the source and the interpreter version do not change (the file header
+   *  holds a second hash and the length of the source). Loaded scripts are
+   *  kept in memory: only the first load of a script in the process reads the
+   *  cache directory. Files are written and touched by the cache thread, not
+   *  by the caller (a worker). Returns the lua status (0 = ok, error message
+   *  on the stack otherwise).
+   */
+  static int load_script(lua_State *L, const std::string &source, const char *name);
+
+  /** Number of scripts loaded from the cache (memory or directory). */
+  static size_t cache_hits();
+
+  /** Directory for compiled scripts (empty = no cache). Returns a copy made
+   *  under the cache lock.
+   */
+  static std::string cache_path();
+
+  /** Change the cache directory. The cache thread of the previous directory
+   *  finishes its pending writes before this returns. A new cache thread
+   *  removes the least recently used files above LUA_CACHE_MAX_FILES once and
+   *  then writes the compiled scripts. Do not call from a worker.
+   */
+  static void set_cache_path(const std::string &path);
+
+  lua_State *state() {
+    return lua_;
+  }
+
+  /** Create a new environment table that reads missing globals from the
+   *  VM's globals. Returns a registry reference to the table.
+   */
+  int new_environment();
+
+  void lock() {
+    pthread_mutex_lock(&mutex_);
+  }
+
+  void unlock() {
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  LuaVM(const void *key);
+
+  ~LuaVM();
+
+  const void *key_;         /**< Pool key (worker). */
+  lua_State *lua_;          /**< Interpreter. */
+  size_t refs_;             /**< Number of nodes using this VM. */
+  int env_meta_ref_;        /**< Metatable for environments {__index = _G}. */
+  pthread_mutex_t mutex_;   /**< Recursive lock held while a node runs lua code. */
+
+  /** Prune the cache directory, then write and touch files until stopped. */
+  static void *cache_thread(void *data);
+
+  static bool sShared;                 /**< Protected by sPoolMutex. */
+  static pthread_mutex_t sPoolMutex;
+
+  static std::string sCachePath;       /**< Protected by sCacheMutex. */
+  static size_t sCacheHits;            /**< Protected by sCacheMutex. */
+  static bool sCacheRunning;           /**< The cache thread should continue (sCacheMutex). */
+  static pthread_t sCacheThread;       /**< Started by set_cache_path. */
+  static pthread_mutex_t sCacheMutex;  /**< Cache path, memory and jobs. */
+  static pthread_cond_t sCacheCond;    /**< Signaled on new jobs or stop. */
+  static pthread_mutex_t sCacheControlMutex; /**< Serializes set_cache_path. */
+};
+
+/** Lock a VM (if any) for the duration of a scope. */
+class LuaVMLock
+{
+ public:
+  LuaVMLock(LuaVM *vm) : vm_(vm) {
+    if (vm_) vm_->lock();
+  }
+
+  ~LuaVMLock() {
+    if (vm_) vm_->unlock();
+  }
+
+ private:
+  LuaVM *vm_;
+};
+
+#endif // RUBYK_SRC_CORE_LUA_VM_H_
@@ -105,6 +105,10 @@ public:
     // build methods from prototype
     klass->make_methods(node);
     
+    // every node can choose its worker (changed with the planet's lock, see Node::move_to)
+    Object *affinity = node->adopt(new TMethod<Node, &Node::affinity>(node, "affinity", RealIO("worker", "Id of the worker (thread) running this node. 0 is the main worker. Nodes already inside a group are not moved.")));
+    affinity->set_context(planet->worker());
+    
 
     node->set_class_url(new_method->parent_->url());  // used by osc (using url instead of name because we might have class folders/subfolders some day).
 
@@ -30,25 +30,85 @@
 #include "node.h"
 #include "inlet.h"
 #include "outlet.h"
+#include "planet.h"
 
 size_t Node::sIdCounter(0);
 
 Node::~Node() {
-  // we have to do this here before ~Node, because some events have to be triggered before the node dies (note off).
-  remove_my_events();
-  unloop_me();
-  
-  for(std::vector<Outlet*>::iterator it = outlets_.begin(); it < outlets_.end(); it++) {
-    delete *it;
-  }
-  
-  for(std::vector<Inlet*>::iterator it = inlets_.begin(); it < inlets_.end(); it++) {
-    delete *it;
-  }
+  // Nodes are deleted with the main worker locked. Our worker reads its inboxes and
+  // events in its own loop and outlets linked to us can live in any worker: stop them
+  // all while we clean up (same as move_to).
+  Planet *planet = TYPE_CAST(Planet, root_);
+  if (planet) planet->lock_workers();
+    // we have to do this here before ~Node, because some events have to be triggered before the node dies (note off).
+    remove_my_events();
+    unloop_me();
+    unblock_me();
+    if (worker_) {
+      worker_->free_messages_for(this);
+      worker_->stats()->forget(this);
+      worker_->profiler()->forget(this);
+    }
+
+    for(std::vector<Outlet*>::iterator it = outlets_.begin(); it < outlets_.end(); it++) {
+      delete *it;
+    }
+
+    for(std::vector<Inlet*>::iterator it = inlets_.begin(); it < inlets_.end(); it++) {
+      delete *it;
+    }
+  if (planet) planet->unlock_workers();
 }
 
 void Node::sort_connections() {
   for(std::vector<Inlet*>::iterator it = inlets_.begin(); it < inlets_.end(); it++) {
     (*it)->sort_incoming_connections();
   }
-}
\ No newline at end of file
+}
+const Value Node::affinity(const Value &val) {
+  if (val.is_real()) {
+    Planet *planet = TYPE_CAST(Planet, root_);
+    Worker *worker = (planet && val.r >= 0) ? planet->worker((size_t)val.r) : NULL;
+    if (!worker) {
+      return Value(BAD_REQUEST_ERROR, std::string("Invalid worker id (use /rubyk/workers to create more workers)."));
+    }
+    if (worker != worker_) move_to(worker);
+  }
+  return worker_ ? Value((Real)worker_->id()) : gNilValue;
+}
+
+void Node::move_to(Worker *worker) {
+  Worker *previous = worker_;
+  bool looped = is_looped();
+  bool blocked = is_block_node();
+  Planet *planet = TYPE_CAST(Planet, root_);
+
+  // outlets sending to us can live in any worker (the main worker is already locked by the caller)
+  if (planet) planet->lock_workers();
+    unloop_me();
+    unblock_me();
+    if (previous) {
+      previous->transfer_events(this, worker);
+      // values in transit to the previous worker are lost
+      previous->free_messages_for(this);
+      previous->stats()->forget(this);
+      previous->profiler()->forget(this);
+    }
+
+    set_context(worker);
+    for(std::vector<Inlet*>::iterator it = inlets_.begin(); it < inlets_.end(); it++) {
+      (*it)->set_context(worker);
+      // recompile connections pointing to this inlet
+      (*it)->sort_incoming_connections();
+    }
+    for(std::vector<Outlet*>::iterator it = outlets_.begin(); it < outlets_.end(); it++) {
+      (*it)->set_context(worker);
+    }
+    for(std::vector<Object*>::iterator it = methods_.begin(); it < methods_.end(); it++) {
+      (*it)->set_context(worker);
+    }
+
+    if (looped) loop_me();
+    if (blocked) block_me();
+  if (planet) planet->unlock_workers();
+}
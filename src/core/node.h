@@ -44,6 +44,9 @@
 
 class Observer;
 
+/** Value of Node::loop_index_ (and block_index_) when the node is not looped. */
+#define NODE_NOT_LOOPED ((size_t)-1)
+
 /** Base class for all nodes in rubyk.
  *
  *  Initialization is done in the following order:
@@ -56,7 +59,7 @@ class Node : public Object {
  public:
   TYPED("Object.Node")
 
-  Node() : Object("n", AnyIO("Node.")), worker_(NULL), looped_(false) {
+  Node() : Object("n", AnyIO("Node.")), worker_(NULL), loop_index_(NODE_NOT_LOOPED), loop_divisor_(1), loop_priority_(LOOP_PRIORITY_NORMAL), block_index_(NODE_NOT_LOOPED), stats_slot_(WORKER_STATS_NO_SLOT), events_(NULL) {
     trigger_position_ = ++sIdCounter; // FIXME: atomic operation
   }
 
@@ -86,6 +89,12 @@ class Node : public Object {
 
   virtual void inspect(Value *hash) const {}
 
+  /** Reserve room for the inlets and outlets built from the class prototypes. */
+  void reserve_slots(size_t inlet_count, size_t outlet_count) {
+    inlets_.reserve(inlet_count);
+    outlets_.reserve(outlet_count);
+  }
+
   /** Add an inlet with the given callback (used by Class during instantiation). */
   void register_inlet(Inlet *inlet) {
     inlet->set_id(inlets_.size()); /* first inlet has id 0 */
@@ -98,6 +107,16 @@ class Node : public Object {
     outlets_.push_back(outlet);
   }
 
+  /** Keep track of a method built from the class prototypes (used by Class during instantiation). */
+  void register_method(Object *method) {
+    methods_.push_back(method);
+  }
+
+  /** Inlets in id order. */
+  const std::vector<Inlet*> &inlets() const {
+    return inlets_;
+  }
+
   /** Remove inlet from inlets list of callbacks. */
   void unregister_inlet(Inlet * inlet) {
     std::vector<Inlet*>::iterator it;
@@ -193,34 +212,89 @@ class Node : public Object {
 
   /** Ask to receive a bang in the given interval in [ms]. */
   inline void bang_me_in(time_t interval) {
-    worker_->register_event(new BangEvent(this, worker_->current_time_ + interval));
+    worker_->register_event(new(worker_->event_pool()) BangEvent(this, worker_->now() + interval));
   }
 
   /** Ask to receive a bang with the given parameter in the given interval in [ms]. */
   inline void bang_me_in(time_t interval, const Value &parameter, bool forced = false) {
-    worker_->register_event(new BangEvent(this, worker_->current_time_ + interval, parameter, forced));
+    worker_->register_event(new(worker_->event_pool()) BangEvent(this, worker_->now() + interval, parameter, forced));
   }
 
   /** Bang me on every loop. */
   inline void loop_me() {
-    if (!looped_) {
-      worker_->register_looped_node(this);
-      looped_ = true;
-    }
+    if (loop_index_ == NODE_NOT_LOOPED) worker_->register_looped_node(this);
   }
 
   /** Stop banging me on every loop. */
   inline void unloop_me() {
-    if (looped_) {
-      worker_->free_looped_node(this);
-      looped_ = false;
+    if (loop_index_ != NODE_NOT_LOOPED && worker_) worker_->free_looped_node(this);
+  }
+
+  /** Return true if the node is banged by the worker's loop. */
+  inline bool is_looped() const { return loop_index_ != NODE_NOT_LOOPED; }
+
+  /** When looped, only bang every 'divisor' loops (IO nodes that do not need
+   *  to be polled every WORKER_SLEEP_MS).
+   */
+  void set_loop_divisor(size_t divisor) {
+    loop_divisor_ = divisor < 1 ? 1 : divisor;
+  }
+
+  size_t loop_divisor() const { return loop_divisor_; }
+
+  /** Set the priority class used when the worker has a loop budget (LOOP_PRIORITY_HIGH,
+   *  LOOP_PRIORITY_NORMAL or LOOP_PRIORITY_LOW).
+   */
+  void set_loop_priority(size_t priority) {
+    if (priority >= WORKER_LOOP_PRIORITIES) priority = WORKER_LOOP_PRIORITIES - 1;
+    if (priority == loop_priority_) return;
+    if (is_looped()) {
+      unloop_me();
+      loop_priority_ = priority;
+      loop_me();
+    } else {
+      loop_priority_ = priority;
     }
   }
 
+  size_t loop_priority() const { return loop_priority_; }
+
+  /** Call process_block on every block tick of the worker (see Worker::set_block_size). */
+  inline void block_me() {
+    if (block_index_ == NODE_NOT_LOOPED) worker_->register_block_node(this);
+  }
+
+  /** Stop block ticks. */
+  inline void unblock_me() {
+    if (block_index_ != NODE_NOT_LOOPED && worker_) worker_->free_block_node(this);
+  }
+
+  /** Return true if the node receives block ticks. */
+  inline bool is_block_node() const { return block_index_ != NODE_NOT_LOOPED; }
+
+  /** Produce 'frames' sample frames in a single call (block tick). Nodes usually fill a
+   *  SignalBuffer and send it with Outlet::send_block.
+   */
+  virtual void process_block(size_t frames) {}
+
+  /** Worker running this node. */
+  inline Worker *worker() { return worker_; }
+
+  /** Get/set the worker running this node (0 = main worker).
+   *  This method must be called with the planet's lock (see NewMethod::cast_create).
+   *  Only this node moves: nodes already inside a Group keep their worker and only
+   *  children created afterwards inherit the new one.
+   */
+  const Value affinity(const Value &val);
+
+  /** Move the node (events, loop, slots) to another worker. */
+  void move_to(Worker *worker);
+
   /** Cast general Mutex context to Worker. */
   virtual void set_context(Mutex *context) {
     // FIXME: what do we do if context is NULL ?? (no more parent)
      // TODO: can we use a static_cast here ?
+    Worker *previous = worker_;
     context_ = context;
     if (context_ != NULL) {
       worker_  = TYPE_CAST(Worker, context_);
@@ -228,17 +302,32 @@ class Node : public Object {
         fprintf(stderr, "Could not cast '%s' to Worker in %s ! Program might crash.\n", context_->class_path(), class_path());
       }
     }
+    if (worker_ != previous) {
+      // statistics slot (allocated here and not in the worker thread)
+      if (previous) previous->stats()->forget(this);
+      if (worker_) worker_->stats()->add(this);
+    }
   }
 
  protected:
   Worker * worker_;  /**< Worker that will give life to object. */
 
  private:
+  friend class EventQueue;
+  friend class Worker;
+  friend class WorkerStats;
+
   static size_t    sIdCounter;   ///< Used to set a default trigger position.
 
   bool is_ok_;                   /**< If something bad arrived to the node during initialization or edit, the node goes into
                                   *   broken state and is_ok_ becomes false. In 'broken' mode, the node does nothing. */
-  bool looped_;                  /**< Set to true if the node is currently called on every worker loop. */
+  size_t loop_index_;            /**< Position in the worker's looped nodes (NODE_NOT_LOOPED if not looped). */
+  size_t loop_divisor_;          /**< Bang every 'loop_divisor_' loops. */
+  size_t loop_priority_;         /**< Priority class in the worker's looped nodes. */
+  size_t block_index_;           /**< Position in the worker's block nodes (NODE_NOT_LOOPED if not ticked). */
+  size_t stats_slot_;            /**< Slot in the worker's statistics (WORKER_STATS_NO_SLOT if none). */
+
+  Event *events_;                /**< Events queued for this node (list maintained by the worker's EventQueue). */
 
   Real trigger_position_;        /**< When sending signals from a particular slot, a node with a small trigger_position_
                                   *   will receive the signal after a node that has a greater trigger_position_. */
@@ -246,6 +335,7 @@ class Node : public Object {
 
   std::vector<Inlet*>  inlets_;  /**< List of inlets. FIXME: is this used ? */
   std::vector<Outlet*> outlets_; /**< List of outlets. */
+  std::vector<Object*> methods_; /**< Methods built from the class (they lock the node's worker). */
 };
 
 #endif // _NODE_H_
\ No newline at end of file
@@ -41,8 +41,16 @@ using namespace oscit;
 #define CLASS_URL   "/class"
 #define LIB_URL     "/class/lib"
 #define INSPECT_URL "/.inspect"
+#define PROFILE_URL "/.profile"
 #define RUBYK_URL   "/rubyk"
 #define LINK_URL    "/rubyk/link"
+#define LOAD_URL    "/rubyk/load"
 #define QUIT_URL    "/rubyk/quit"
+#define WORKERS_URL "/rubyk/workers"
+#define WORKER_URL  "/rubyk/worker"
+#define LUA_URL     "/rubyk/lua"
+#define STATS_URL   "/rubyk/stats"
+#define STATS_SNAPSHOT_URL "/rubyk/stats/snapshot"
+#define PROFILER_URL "/rubyk/profile"
 
 #endif
\ No newline at end of file
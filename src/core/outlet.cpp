@@ -35,11 +35,77 @@
 // FIXME: inline ?
 void Outlet::send(const Value &val)
 {  
-  LinkedList<Inlet*> * iterator = (LinkedList<Inlet*> *)(connections_.begin());
+  Worker *worker = node_->worker();
+  Profiler *profiler = (worker && worker->profiler()->enabled()) ? worker->profiler() : NULL;
   
-  while(iterator) {
-    iterator->obj->receive(val);
-    iterator = iterator->next;
+  // an inlet can change our connections: plan_ stays in place until we are done
+  ++sending_;
+  for(size_t i = 0; i < plan_.size(); ++i) {
+    const OutletConnection &connection = plan_[i];
+    if (!connection.inlet_) continue; // removed during this send
+    if (connection.worker_ == worker || !connection.worker_ || !worker) {
+      if (profiler) {
+        profiler->enter(connection.inlet_->node());
+          (*connection.method_)(connection.inlet_, val);
+        profiler->leave();
+      } else {
+        (*connection.method_)(connection.inlet_, val);
+      }
+    } else {
+      // inlet lives in another thread
+      connection.worker_->post_value(worker, connection.inlet_, val);
+    }
+  }
+  done_sending();
+}
+
+void Outlet::send_block(const SignalBlock &block)
+{
+  Worker *worker = node_->worker();
+  Profiler *profiler = (worker && worker->profiler()->enabled()) ? worker->profiler() : NULL;
+  
+  ++sending_;
+  for(size_t i = 0; i < plan_.size(); ++i) {
+    const OutletConnection &connection = plan_[i];
+    if (!connection.inlet_) continue; // removed during this send
+    if (connection.worker_ == worker || !connection.worker_ || !worker) {
+      if (profiler) {
+        profiler->enter(connection.inlet_->node());
+          connection.inlet_->receive_block(block);
+        profiler->leave();
+      } else {
+        connection.inlet_->receive_block(block);
+      }
+    } else {
+      for (size_t f = 0; f < block.frames_; ++f) {
+        connection.worker_->post_value(worker, connection.inlet_, block.frame_value(f));
+      }
+    }
+  }
+  done_sending();
+}
+
+void Outlet::connections_changed()
+{
+  OutletConnection connection;
+  
+  if (sending_) {
+    // Called from a receiver while we iterate over plan_: do not move it. Disable the
+    // connections that are gone and rebuild once the send is finished.
+    for (size_t i = 0; i < plan_.size(); ++i) {
+      if (plan_[i].inlet_ && !is_connected_to(plan_[i].inlet_)) plan_[i].inlet_ = NULL;
+    }
+    plan_stale_ = true;
+    return;
+  }
+  
+  plan_stale_ = false;
+  plan_.clear();
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    connection.inlet_  = (Inlet*)connections_[i];
+    connection.method_ = connection.inlet_->method();
+    connection.worker_ = connection.inlet_->node()->worker();
+    plan_.push_back(connection);
   }
 }
 
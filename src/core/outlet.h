@@ -30,6 +30,11 @@
 #ifndef _OUTLET_H_
 #define _OUTLET_H_
 #include "slot.h"
+#include "inlet.h"
+
+#include <vector>
+
+class Worker;
 
 /** Prototype constructor for Inlets. */
 struct OutletPrototype
@@ -39,30 +44,49 @@ struct OutletPrototype
   Value       type_;
 };
 
+/** A connection compiled for fast sending: everything needed to call the inlet
+ *  without chasing pointers.
+ */
+struct OutletConnection
+{
+  Inlet          *inlet_;   /**< Receiving inlet. */
+  inlet_method_t  method_;  /**< Inlet's receive method. */
+  Worker         *worker_;  /**< Worker of the inlet's node when the connection was compiled. */
+};
+
 class Outlet : public Slot {
 public:
   TYPED("Object.Slot.Outlet")
   
-  Outlet(Node *node, const Value &type) : Slot(node, type) {
+  Outlet(Node *node, const Value &type) : Slot(node, type), sending_(0), plan_stale_(false) {
     register_in_node();
   }
   
-  Outlet(Node *node, const std::string &name, const Value &type) : Slot(node, name, type) {
+  Outlet(Node *node, const std::string &name, const Value &type) : Slot(node, name, type), sending_(0), plan_stale_(false) {
     register_in_node();
   }
   
-  Outlet(Node *node, const char *name, const Value &type) : Slot(node, name, type) {
+  Outlet(Node *node, const char *name, const Value &type) : Slot(node, name, type), sending_(0), plan_stale_(false) {
     register_in_node();
   }
   
   /** Prototype based constructor. */
-  Outlet(Node *node, const OutletPrototype &prototype) : Slot(node, prototype.name_, prototype.type_) {
+  Outlet(Node *node, const OutletPrototype &prototype) : Slot(node, prototype.name_, prototype.type_), sending_(0), plan_stale_(false) {
     register_in_node();
   }
   
   virtual ~Outlet() {
     unregister_in_node();
   }
+
+  /** Outlets are allocated from a slab: a patch creates many of them with the same size. */
+  static void *operator new(size_t size) {
+    return SlabAllocator<Outlet>::allocate(size);
+  }
+
+  static void operator delete(void *ptr, size_t size) {
+    SlabAllocator<Outlet>::release(ptr, size);
+  }
   
   /** Inform the node about the existence of this outlet (direct callback). */
   void register_in_node();
@@ -70,8 +94,30 @@ public:
   /** Inform the node that this outlet is about to disappear. */
   void unregister_in_node();
   
-  /** Send the signal to all connections. Do nothing if there are no connections. */
+  /** Send the signal to all connections. Do nothing if there are no connections.
+   *  Inlets in other workers receive the value on their worker's next loop.
+   */
   void send(const Value &val);
+  
+  /** Send a block of frames to all connections: a single call per inlet with a block
+   *  method, one call per frame otherwise (frames are posted one by one to inlets in
+   *  other workers).
+   */
+  void send_block(const SignalBlock &block);
+  
+protected:
+  /** Rebuild the compiled connections (delayed until the end of the current send). */
+  virtual void connections_changed();
+  
+private:
+  /** End of a send: apply connection changes made by the receivers. */
+  void done_sending() {
+    if (--sending_ == 0 && plan_stale_) connections_changed();
+  }
+
+  std::vector<OutletConnection> plan_; /**< Connections in sending order (copy of connections_). */
+  size_t sending_;                     /**< Depth of send calls in progress (feedback loops). */
+  bool plan_stale_;                    /**< Connections changed during a send. */
 };
 
 #endif
@@ -29,21 +29,86 @@
 
 #include "node.h"
 #include "class_finder.h"
+#include "lua_vm.h"
 #include "text_command.h"
 #include "planet.h"
 
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sys/mman.h>  // mlockall
+
+Planet::~Planet() {
+  stop_stats_dump();
+  for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->kill();
+  clear(); // nodes must die before their worker
+  for (size_t i = 0; i < workers_.size(); ++i) delete workers_[i];
+  pthread_mutex_destroy(&stats_mutex_);
+}
+
 void Planet::init() {
   set_context(&worker_);
+  pthread_mutex_init(&stats_mutex_, NULL);
+  stats_snapshot_id_ = 0;
 
   // build application methods
   //           /.inspect
   adopt(new TMethod<Planet, &Planet::inspect>(this, Url(INSPECT_URL).name(), StringIO("url", "Returns some information on the state of a node.")));
+  //           /.profile
+  adopt(new TMethod<Planet, &Planet::profile>(this, Url(PROFILE_URL).name(), StringIO("url", "Returns [inclusive us, exclusive us, calls] for a node (profiler must be enabled).")));
   //          /class
   classes_ = adopt(new ClassFinder(Url(CLASS_URL).name(), DEFAULT_OBJECTS_LIB_PATH));
   //          /rubyk
   Object *rubyk = adopt(new Object(Url(RUBYK_URL).name()));
   //          /rubyk/link [[["","source url"],["", "target url"]], "Create a link between two urls."]
   rubyk->adopt(new TMethod<Planet, &Planet::link>(this, Url(LINK_URL).name(), JsonValue("[['','', ''],'url','op','url','Update a link between the two provided urls. Operations are '=>' (link) '||' (unlink) or '?' (pending).']")));
+  //          /rubyk/load
+  rubyk->adopt(new TMethod<Planet, &Planet::load_report>(this, Url(LOAD_URL).name(), NilIO("Timing of the last bulk load {parse, links, sort, total} [ms] and link counts.")));
+  //          /rubyk/workers
+  rubyk->adopt(new TMethod<Planet, &Planet::workers>(this, Url(WORKERS_URL).name(), RealIO("count", "Number of threads running nodes (see 'affinity' in nodes).")));
+  //          /rubyk/worker
+  Object *worker = rubyk->adopt(new Object(Url(WORKER_URL).name()));
+  //          /rubyk/worker/priority
+  worker->adopt(new TMethod<Planet, &Planet::worker_priority>(this, "priority", RangeIO(0, 99, "priority", "Realtime (SCHED_FIFO) priority of the workers. 0 = default.")));
+  //          /rubyk/worker/cpus
+  worker->adopt(new TMethod<Planet, &Planet::worker_cpus>(this, "cpus", AnyIO("List of cpus: worker 'i' runs on cpus[i % size] (linux only).")));
+  //          /rubyk/worker/mlock
+  worker->adopt(new TMethod<Planet, &Planet::worker_mlock>(this, "mlock", RangeIO(0, 1, "lock", "Lock memory pages in RAM (mlockall).")));
+  //          /rubyk/worker/prefault
+  worker->adopt(new TMethod<Planet, &Planet::worker_prefault>(this, "prefault", RealIO("KB", "Stack size touched by the workers on start.")));
+  //          /rubyk/worker/deadline
+  worker->adopt(new TMethod<Planet, &Planet::worker_deadline>(this, "deadline", RangeIO(0, 1, "deadline", "Sleep until next event instead of polling.")));
+  //          /rubyk/worker/block_size
+  worker->adopt(new TMethod<Planet, &Planet::worker_block_size>(this, "block_size", RealIO("frames", "Frames produced by block nodes on each block tick (0 = off).")));
+  //          /rubyk/worker/block_rate
+  worker->adopt(new TMethod<Planet, &Planet::worker_block_rate>(this, "block_rate", RealIO("Hz", "Sample rate of block nodes.")));
+  //          /rubyk/worker/budget
+  worker->adopt(new TMethod<Planet, &Planet::worker_budget>(this, "budget", RealIO("us", "Time per loop after which looped nodes are deferred (0 = no limit).")));
+  //          /rubyk/lua
+  Object *lua = rubyk->adopt(new Object(Url(LUA_URL).name()));
+  //          /rubyk/lua/shared
+  lua->adopt(new TMethod<Planet, &Planet::lua_shared>(this, "shared", RangeIO(0, 1, "shared", "New Lua nodes share one interpreter per worker (process-wide setting).")));
+  //          /rubyk/lua/cache
+  lua->adopt(new TMethod<Planet, &Planet::lua_cache>(this, "cache", StringIO("path", "Directory for compiled Lua scripts (empty = no cache, process-wide setting).")));
+  //          /rubyk/stats
+  Object *stats = rubyk->adopt(new Object(Url(STATS_URL).name()));
+  stats->adopt(new TMethod<Planet, &Planet::stats_enable>(this, "enable", RangeIO(0, 1, "enable", "Record loop timing, event lateness and time spent in nodes.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_reset>(this, "reset", NilIO("Clear statistics.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_loops>(this, "loops", NilIO("Loop timing {count, last, average, max} in [us] and deferred loops/nodes.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_lateness>(this, "lateness", NilIO("Event lateness histogram: [0,1[ [1,2[ [2,4[ ... [ms].")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_events>(this, "events", NilIO("Events per tick {total, last, max, missed}.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_nodes>(this, "nodes", NilIO("Time spent in nodes {url: [us, calls]}.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_report>(this, "report", NilIO("All statistics by worker id.")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_dump>(this, "dump", JsonValue("[['', 0], 'path', 'seconds', 'Append a report to a file at a regular interval.']")));
+  stats->adopt(new TMethod<Planet, &Planet::stats_snapshot>(this, Url(STATS_SNAPSHOT_URL).name(), NilIO("Prepare a report for the dump thread (internal).")));
+  //          /rubyk/profile
+  Object *profiler = rubyk->adopt(new Object(Url(PROFILER_URL).name()));
+  profiler->adopt(new TMethod<Planet, &Planet::profile_enable>(this, "enable", RangeIO(0, 1, "enable", "Record time spent in nodes for every call path.")));
+  profiler->adopt(new TMethod<Planet, &Planet::profile_reset>(this, "reset", NilIO("Clear profiles.")));
+  profiler->adopt(new TMethod<Planet, &Planet::profile_dump>(this, "dump", StringIO("path", "Write profiles as folded stacks (flamegraph.pl input).")));
   //          /rubyk/quit
   rubyk->adopt(new TMethod<Planet, &Planet::quit>(this, Url(QUIT_URL).name(), NilIO("Stop all operations and quit.")));
 }
@@ -52,7 +117,17 @@ void Planet::init() {
 const Value Planet::link(const Value &val) {
   // std::cout << "link: " << val << std::endl;
   if (val.is_nil()) {
-    return create_pending_links();
+    // during a bulk load, links are resolved once at the end
+    return bulk_loading_ ? gNilValue : create_pending_links();
+  }
+
+  if (bulk_loading_) {
+    if (val[1].str() == "=>") {
+      return add_pending_link(val);
+    } else if (val[1].str() == "||") {
+      Value res = remove_pending_link(val);
+      if (!res.is_nil()) return res;
+    }
   }
 
   Value error;
@@ -68,6 +143,14 @@ const Value Planet::link(const Value &val) {
     return val;
   }
 
+  // connections are read by the workers of both nodes
+  lock_workers();
+    Value res = change_link(source, val);
+  unlock_workers();
+  return res;
+}
+
+const Value Planet::change_link(Object *source, const Value &val) {
   Slot   *slot = TYPE_CAST(Slot, source);
   Object *object;
   if (slot != NULL) {
@@ -84,6 +167,98 @@ const Value Planet::link(const Value &val) {
   }
 }
 
+/** Find class names used in a patch ("v = Value(3)" --> "Value"). */
+static void referenced_classes(const std::string &line, std::set<std::string> *found) {
+  size_t pos = 0;
+  while ( (pos = line.find('=', pos)) != std::string::npos ) {
+    ++pos;
+    if (pos < line.size() && line[pos] == '>') continue; // link
+    size_t start = pos;
+    while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) ++start;
+    size_t end = start;
+    while (end < line.size() && (isalnum(line[end]) || line[end] == '_')) ++end;
+    if (end > start && end < line.size() && line[end] == '(' && isupper(line[start])) {
+      found->insert(line.substr(start, end - start));
+    }
+  }
+}
+
+/** Scan a patch file line by line (the file is not loaded in memory). */
+static void referenced_classes_in_file(const std::string &path, Value *names) {
+  std::ifstream in(path.c_str(), std::ios::in);
+  std::set<std::string> found;
+  std::string line;
+  while (std::getline(in, line)) {
+    referenced_classes(line, &found);
+  }
+  for (std::set<std::string>::iterator it = found.begin(); it != found.end(); ++it) {
+    names->push_back(Value(*it));
+  }
+}
+
+const Value Planet::load_file(const std::string &path) {
+  begin_bulk_load();
+    // open all the libraries before creating nodes
+    Value classes;
+    referenced_classes_in_file(path, &classes);
+    if (classes.size() > 0) classes_->preload(classes);
+
+    TextCommand * command = adopt_command(new TextCommand(std::cin, std::cout), false);
+    command->set_silent();
+    command->parse_file(path.c_str());
+    delete command;
+  return end_bulk_load();
+}
+
+void Planet::begin_bulk_load() {
+  if (bulk_loading_) return;
+  bulk_loading_  = true;
+  load_start_ns_ = Profiler::now_ns();
+  sort_batch_.begin();
+}
+
+const Value Planet::end_bulk_load() {
+  if (!bulk_loading_) return load_report_;
+  bulk_loading_ = false;
+
+  long long parsed = Profiler::now_ns();
+  Value links = resolve_pending_links();
+  long long linked = Profiler::now_ns();
+  sort_batch_.end();
+  long long sorted = Profiler::now_ns();
+
+  HashValue report;
+  report.set("parse",   Value((parsed - load_start_ns_) / 1000000.0));
+  report.set("links",   Value((linked - parsed) / 1000000.0));
+  report.set("sort",    Value((sorted - linked) / 1000000.0));
+  report.set("total",   Value((sorted - load_start_ns_) / 1000000.0));
+  report.set("created", Value((Real)links.size()));
+  report.set("pending", Value((Real)pending_links_.size()));
+  load_report_ = report;
+  return load_report_;
+}
+
+const Value Planet::resolve_pending_links() {
+  std::list<Call>::iterator it  = pending_links_.begin();
+  std::list<Call>::iterator end = pending_links_.end();
+  Value list;
+
+  // single pass: urls are looked up in the root's index, no call is retried
+  lock_workers();
+    while (it != end) {
+      Value error;
+      Object *source = object_at(Url(it->param_[0].str()), &error);
+      if (!error.is_error() && object_at(Url(it->param_[2].str()), &error)) {
+        list.push_back(change_link(source, it->param_));
+        it = pending_links_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  unlock_workers();
+  return list;
+}
+
 // FIXME: on node deletion/replacement, remove/move all pending links related to this node ?.
 const Value Planet::create_pending_links() {
   std::list<Call>::iterator it  = pending_links_.begin();
@@ -105,7 +280,6 @@ const Value Planet::create_pending_links() {
   return list;
 }
 
-
 // FIXME: on node deletion/replacement, remove/move all pending links related to this node ?.
 const Value Planet::remove_pending_link(const Value &val) {
   std::list<Call>::iterator it  = pending_links_.begin();
@@ -131,10 +305,429 @@ const Value Planet::remove_pending_link(const Value &val) {
 const Value Planet::inspect(const Value &val) {
   std::cout << "## inspect " << val << "\n";
   if (!val.is_string()) return Value(BAD_REQUEST_ERROR, "Bad arguments:'inspect' should be called with an url.");
+  if (val.str() == WORKER_URL) return worker_settings();
   Value res;
   Object *object = find_or_build_object_at(val.str(), &res);
   if (!object) return res;
   Node *node = TYPE_CAST(Node, object);
   if (!node) return Value(BAD_REQUEST_ERROR, std::string("Bad target '").append(object->url()).append("':inspect only works on Nodes (class is '").append(object->class_path()).append("')."));
   return node->do_inspect();
-}
\ No newline at end of file
+}
+const Value Planet::workers(const Value &val) {
+  if (val.is_real()) {
+    size_t count = val.r < 1 ? 1 : (size_t)val.r;
+    if (count > PLANET_MAX_WORKERS) {
+      return Value(BAD_REQUEST_ERROR, "Too many workers.");
+    } else if (count < worker_count()) {
+      return Value(BAD_REQUEST_ERROR, "Cannot remove workers.");
+    }
+
+    size_t first_new = workers_.size();
+    while (worker_count() < count) {
+      Worker *worker = new Worker(this, &worker_, worker_count());
+      configure_worker(worker, worker_count());
+      workers_.push_back(worker);
+    }
+
+    // every worker needs an inbox for each other worker
+    lock_workers();
+      worker_.set_worker_count(count);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_worker_count(count);
+    unlock_workers();
+
+    if (running_) {
+      for (size_t i = first_new; i < workers_.size(); ++i) workers_[i]->start();
+    }
+  }
+  return Value((Real)worker_count());
+}
+
+int Planet::parse_options(int argc, char * argv[]) {
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i) {
+    std::string option(argv[i] + 2);
+    if (option == "mlock") {
+      worker_mlock(Value(1.0));
+    } else if (option == "deadline") {
+      worker_deadline(Value(1.0));
+    } else if (option == "async") {
+      async_commands_ = true;
+    } else if (option == "lua-shared") {
+      lua_shared(Value(1.0));
+    } else if (i + 1 < argc && option == "priority") {
+      worker_priority(Value(atof(argv[++i])));
+    } else if (i + 1 < argc && option == "lua-cache") {
+      lua_cache(Value(argv[++i]));
+    } else if (i + 1 < argc && option == "budget") {
+      worker_budget(Value(atof(argv[++i])));
+    } else if (i + 1 < argc && option == "prefault") {
+      worker_prefault(Value(atof(argv[++i])));
+    } else if (i + 1 < argc && option == "cpus") {
+      // --cpus 2,3
+      Value cpus;
+      char *cpu = argv[++i];
+      while (*cpu) {
+        cpus.push_back(Value((Real)strtol(cpu, &cpu, 10)));
+        if (*cpu == ',') ++cpu;
+        else if (*cpu) break; // bad format
+      }
+      worker_cpus(cpus);
+    } else {
+      fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+    }
+  }
+  return i;
+}
+
+void Planet::configure_worker(Worker *worker, size_t id) {
+  worker->set_priority(worker_.priority());
+  worker->set_prefault_stack(worker_.prefault_stack());
+  worker->set_deadline_mode(worker_.deadline_mode());
+  worker->set_loop_budget(worker_.loop_budget());
+  worker->set_block_size(worker_.block_size());
+  worker->set_block_rate(worker_.block_rate());
+  if (worker_cpus_.is_list() && worker_cpus_.size() > 0) {
+    worker->set_cpu((int)worker_cpus_[id % worker_cpus_.size()].r);
+  } else if (worker_cpus_.is_real()) {
+    worker->set_cpu((int)worker_cpus_.r);
+  } else {
+    worker->set_cpu(-1);
+  }
+}
+
+const Value Planet::worker_priority(const Value &val) {
+  if (val.is_real()) {
+    lock_workers();
+      worker_.set_priority((int)val.r);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_priority((int)val.r);
+    unlock_workers();
+  }
+  return Value((Real)worker_.priority());
+}
+
+const Value Planet::worker_cpus(const Value &val) {
+  if (val.is_list() || val.is_real()) {
+    worker_cpus_ = val;
+    lock_workers();
+      configure_worker(&worker_, 0);
+      for (size_t i = 0; i < workers_.size(); ++i) configure_worker(workers_[i], i + 1);
+    unlock_workers();
+  }
+  return worker_cpus_;
+}
+
+const Value Planet::worker_mlock(const Value &val) {
+  if (val.is_real()) {
+    if (val.r && !memory_locked_) {
+      if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        memory_locked_ = true;
+      } else {
+        return Value(INTERNAL_SERVER_ERROR, std::string("Could not lock memory (").append(strerror(errno)).append(")."));
+      }
+    } else if (!val.r && memory_locked_) {
+      munlockall();
+      memory_locked_ = false;
+    }
+  }
+  return Value(memory_locked_ ? 1.0 : 0.0);
+}
+
+const Value Planet::worker_prefault(const Value &val) {
+  if (val.is_real() && val.r >= 0) {
+    if (!worker_.set_prefault_stack((size_t)val.r)) {
+      char max[32];
+      snprintf(max, sizeof(max), "%lu", (unsigned long)Worker::max_prefault_stack());
+      return Value(BAD_REQUEST_ERROR, std::string("Prefault larger than half of the thread stack (max ").append(max).append(" KB)."));
+    }
+    lock_workers();
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_prefault_stack((size_t)val.r);
+    unlock_workers();
+  }
+  return Value((Real)worker_.prefault_stack());
+}
+
+const Value Planet::worker_deadline(const Value &val) {
+  if (val.is_real()) {
+    worker_.set_deadline_mode(val.r != 0);
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_deadline_mode(val.r != 0);
+  }
+  return Value(worker_.deadline_mode() ? 1.0 : 0.0);
+}
+
+const Value Planet::worker_block_size(const Value &val) {
+  if (val.is_real() && val.r >= 0) {
+    lock_workers();
+      worker_.set_block_size((size_t)val.r);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_block_size((size_t)val.r);
+    unlock_workers();
+  }
+  return Value((Real)worker_.block_size());
+}
+
+const Value Planet::worker_block_rate(const Value &val) {
+  if (val.is_real() && val.r >= 0) {
+    lock_workers();
+      worker_.set_block_rate(val.r);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_block_rate(val.r);
+    unlock_workers();
+  }
+  return Value(worker_.block_rate());
+}
+
+const Value Planet::worker_budget(const Value &val) {
+  if (val.is_real() && val.r >= 0) {
+    worker_.set_loop_budget((long long)val.r);
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->set_loop_budget((long long)val.r);
+  }
+  return Value((Real)worker_.loop_budget());
+}
+
+const Value Planet::lua_shared(const Value &val) {
+  if (val.is_real()) {
+    LuaVM::set_shared(val.r != 0);
+  }
+  return Value(LuaVM::shared() ? 1.0 : 0.0);
+}
+
+const Value Planet::lua_cache(const Value &val) {
+  if (val.is_string()) {
+    LuaVM::set_cache_path(val.str());
+  }
+  return Value(LuaVM::cache_path());
+}
+
+const Value Planet::worker_settings() {
+  HashValue settings;
+  settings.set("priority", worker_priority(gNilValue));
+  settings.set("cpus",     worker_cpus(gNilValue));
+  settings.set("mlock",    worker_mlock(gNilValue));
+  settings.set("prefault", worker_prefault(gNilValue));
+  settings.set("deadline", worker_deadline(gNilValue));
+  settings.set("budget",   worker_budget(gNilValue));
+  settings.set("block_size", worker_block_size(gNilValue));
+  settings.set("block_rate", worker_block_rate(gNilValue));
+  settings.set("workers",  Value((Real)worker_count()));
+
+  // state reached by each worker thread (a failed call keeps the previous state)
+  Value applied;
+  for (size_t i = 0; i < worker_count(); ++i) {
+    Worker *w = worker(i);
+    HashValue state;
+    state.set("priority", Value((Real)w->applied_priority()));
+    state.set("cpu",      Value((Real)w->applied_cpu()));
+    state.set("prefault", Value((Real)w->applied_prefault()));
+    applied.push_back(state);
+  }
+  settings.set("applied", applied);
+  return settings;
+}
+
+const Value Planet::stats_enable(const Value &val) {
+  if (val.is_real()) {
+    lock_workers();
+      worker_.stats()->set_enabled(val.r != 0);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->stats()->set_enabled(val.r != 0);
+    unlock_workers();
+  }
+  return Value(worker_.stats()->enabled() ? 1.0 : 0.0);
+}
+
+const Value Planet::stats_reset(const Value &val) {
+  lock_workers();
+    worker_.stats()->reset();
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->stats()->reset();
+  unlock_workers();
+  return gNilValue;
+}
+
+void Planet::merged_stats(WorkerStats *stats) {
+  stats->merge(*worker_.stats());
+  for (size_t i = 0; i < workers_.size(); ++i) stats->merge(*workers_[i]->stats());
+}
+
+const Value Planet::stats_loops(const Value &val) {
+  WorkerStats stats;
+  lock_workers();
+    merged_stats(&stats);
+  unlock_workers();
+  return stats.loops();
+}
+
+const Value Planet::stats_lateness(const Value &val) {
+  WorkerStats stats;
+  lock_workers();
+    merged_stats(&stats);
+  unlock_workers();
+  return stats.lateness();
+}
+
+const Value Planet::stats_events(const Value &val) {
+  WorkerStats stats;
+  lock_workers();
+    merged_stats(&stats);
+  unlock_workers();
+  return stats.events();
+}
+
+const Value Planet::stats_nodes(const Value &val) {
+  WorkerStats stats;
+  lock_workers();
+    merged_stats(&stats);
+  unlock_workers();
+  return stats.nodes();
+}
+
+const Value Planet::stats_report(const Value &val) {
+  HashValue res;
+  std::ostringstream id;
+  lock_workers();
+    res.set("0", worker_.stats()->report());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      id.str("");
+      id << (i + 1);
+      res.set(id.str(), workers_[i]->stats()->report());
+    }
+  unlock_workers();
+  return res;
+}
+
+const Value Planet::stats_dump(const Value &val) {
+  if (val.is_nil()) {
+    stop_stats_dump();
+  } else if (val.type_id() == H("sf") && val[1].r > 0) {
+    stop_stats_dump();
+    stats_path_     = val[0].str();
+    stats_interval_ = val[1].r;
+    stats_dumping_  = true;
+    if (pthread_create(&stats_thread_, NULL, stats_dump_thread, this)) {
+      stats_dumping_ = false;
+      return Value(INTERNAL_SERVER_ERROR, "Could not start statistics dump thread.");
+    }
+  } else {
+    return Value(BAD_REQUEST_ERROR, "Bad arguments: dump should be called with [path, seconds].");
+  }
+
+  if (!stats_dumping_) return gNilValue;
+  return Value(stats_path_).push_back(Value(stats_interval_));
+}
+
+void Planet::stop_stats_dump() {
+  // The dump thread never takes a worker lock: we can join with the worker locked.
+  if (stats_dumping_) {
+    stats_dumping_ = false;
+    pthread_join(stats_thread_, NULL);
+  }
+}
+
+const Value Planet::stats_snapshot(const Value &val) {
+  // main worker is locked (posted call)
+  std::ostringstream line;
+  line << worker_.current_time_ << " " << stats_report(gNilValue).to_json() << "\n";
+  pthread_mutex_lock(&stats_mutex_);
+    stats_snapshot_ = line.str();
+    ++stats_snapshot_id_;
+  pthread_mutex_unlock(&stats_mutex_);
+  return gNilValue;
+}
+
+void *Planet::stats_dump_thread(void *data) {
+  Planet *planet = (Planet*)data;
+  struct timespec sleeper;
+  sleeper.tv_sec  = 0;
+  sleeper.tv_nsec = 100 * 1000000; // check for stop every 100 [ms]
+  Real waited = 0;
+  size_t written_id;
+  std::string line;
+
+  pthread_mutex_lock(&planet->stats_mutex_);
+    written_id = planet->stats_snapshot_id_; // ignore reports from a previous dump
+  pthread_mutex_unlock(&planet->stats_mutex_);
+
+  while (planet->stats_dumping_) {
+    nanosleep(&sleeper, NULL);
+
+    // write the report prepared by the worker since our last request
+    line.clear();
+    pthread_mutex_lock(&planet->stats_mutex_);
+      if (planet->stats_snapshot_id_ != written_id) {
+        written_id = planet->stats_snapshot_id_;
+        line = planet->stats_snapshot_;
+      }
+    pthread_mutex_unlock(&planet->stats_mutex_);
+
+    if (!line.empty()) {
+      // file io without any lock
+      std::ofstream out(planet->stats_path_.c_str(), std::ios::out | std::ios::app);
+      out << line;
+    }
+
+    waited += 0.1;
+    if (waited < planet->stats_interval_) continue;
+    waited = 0;
+
+    // Ask the main worker for a report instead of locking it: stop_stats_dump
+    // joins this thread with the worker lock held.
+    planet->worker_.post(STATS_SNAPSHOT_URL, gNilValue);
+  }
+  return NULL;
+}
+
+const Value Planet::profile(const Value &val) {
+  std::map<std::string, ProfileTotals> totals;
+  lock_workers();
+    worker_.profiler()->collect(&totals);
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->profiler()->collect(&totals);
+  unlock_workers();
+
+  if (val.is_string()) {
+    std::map<std::string, ProfileTotals>::iterator it = totals.find(val.str());
+    if (it == totals.end()) return Value(NOT_FOUND_ERROR, std::string("No profile for '").append(val.str()).append("'."));
+    return Value((Real)(it->second.inclusive_ns_ / 1000)).push_back(Value((Real)(it->second.exclusive_ns_ / 1000))).push_back(Value((Real)it->second.calls_));
+  }
+
+  HashValue res;
+  std::map<std::string, ProfileTotals>::iterator it;
+  std::map<std::string, ProfileTotals>::iterator end = totals.end();
+  for (it = totals.begin(); it != end; ++it) {
+    res.set(it->first, Value((Real)(it->second.inclusive_ns_ / 1000)).push_back(Value((Real)(it->second.exclusive_ns_ / 1000))).push_back(Value((Real)it->second.calls_)));
+  }
+  return res;
+}
+
+const Value Planet::profile_enable(const Value &val) {
+  if (val.is_real()) {
+    lock_workers();
+      worker_.profiler()->set_enabled(val.r != 0);
+      for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->profiler()->set_enabled(val.r != 0);
+    unlock_workers();
+  }
+  return Value(worker_.profiler()->enabled() ? 1.0 : 0.0);
+}
+
+const Value Planet::profile_reset(const Value &val) {
+  lock_workers();
+    worker_.profiler()->reset();
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->profiler()->reset();
+  unlock_workers();
+  return gNilValue;
+}
+
+const Value Planet::profile_dump(const Value &val) {
+  if (!val.is_string()) return Value(BAD_REQUEST_ERROR, "Bad arguments: dump should be called with a file path.");
+
+  std::ostringstream folded;
+  std::ostringstream prefix;
+  lock_workers();
+    worker_.profiler()->write_folded(folded, "worker0");
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      prefix.str("");
+      prefix << "worker" << (i + 1);
+      workers_[i]->profiler()->write_folded(folded, prefix.str());
+    }
+  unlock_workers();
+
+  std::ofstream out(val.str().c_str(), std::ios::out | std::ios::trunc);
+  if (!out) return Value(INTERNAL_SERVER_ERROR, std::string("Could not write profile to '").append(val.str()).append("'."));
+  out << folded.str();
+  return val;
+}
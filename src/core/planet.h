@@ -41,6 +41,8 @@ class ClassFinder;
 
 #define DEFAULT_OBJECTS_LIB_PATH "/usr/local/lib/rubyk"
 #define RUBYK_DEFAULT_NAME "rubyk"
+// Maximal number of workers (threads running nodes).
+#define PLANET_MAX_WORKERS 64
 
 /** A planet is just a root with a worker. */
 class Planet : public Root
@@ -48,32 +50,26 @@ class Planet : public Root
  public:
   TYPED("Object.Root.Planet")
 
-  Planet() : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL) {
+  Planet() : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL), running_(false), memory_locked_(false), async_commands_(false), stats_dumping_(false), bulk_loading_(false), load_start_ns_(0) {
     init();
   }
 
-  Planet(uint port) : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL) {
+  Planet(uint port) : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL), running_(false), memory_locked_(false), async_commands_(false), stats_dumping_(false), bulk_loading_(false), load_start_ns_(0) {
     init();
     open_port(port);
   }
 
-  Planet(int argc, char * argv[]) : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL) {
+  /** Usage: rubyk [--priority 80] [--cpus 2,3] [--mlock] [--prefault 512] [--deadline] [--budget 500] [--lua-shared] [--lua-cache dir] [--async] [file.rk] */
+  Planet(int argc, char * argv[]) : Root(RUBYK_DEFAULT_NAME), worker_(this), classes_(NULL), running_(false), memory_locked_(false), async_commands_(false), stats_dumping_(false), bulk_loading_(false), load_start_ns_(0) {
     // TODO: get port from command line
     init();
 
-    if (argc > 1) {
-      std::string file_name(argv[1]);
+    int file_index = parse_options(argc, argv);
+
+    if (file_index < argc) {
+      std::string file_name(argv[file_index]);
       set_name(file_name.substr(0, file_name.rfind(".")));
-      std::ifstream in(argv[1], std::ios::in);
-      std::ostringstream oss;
-      oss << in.rdbuf();
-      in.close();
-
-      TextCommand * command = adopt_command(new TextCommand(std::cin, std::cout), false);
-      command->set_silent();
-      oss << "\n";
-      command->parse(oss.str());
-      delete command;
+      load_file(file_name);
     }
   }
 
@@ -83,25 +79,36 @@ class Planet : public Root
     adopt_command(new OscCommand("oscit", "_oscit._udp", port));
   }
 
+  virtual ~Planet();
+
   void start() {
+    running_ = true;
     worker_.start();
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->start();
   }
 
   /** Only used with direct loop control. */
   void should_run(bool should_run) {
     worker_.should_run(should_run);
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->should_run(should_run);
   }
 
   void join() {
     worker_.join();
+    // the main worker decides when to quit
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->kill();
   }
 
   void quit() {
+    stop_stats_dump();
     worker_.kill();
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->kill();
     clear(); // kill commands and destroy objects
   }
 
+  /** Run a single step in all workers (direct loop control). */
   bool loop() {
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->loop();
     return worker_.loop();
   }
 
@@ -111,9 +118,54 @@ class Planet : public Root
 
   inline Worker *worker() { return &worker_; }
 
+  /** Return the worker with the given id or NULL (0 = main worker). */
+  inline Worker *worker(size_t id) {
+    if (id == 0) return &worker_;
+    return id <= workers_.size() ? workers_[id - 1] : NULL;
+  }
+
+  /** Number of workers including the main worker. */
+  size_t worker_count() const { return workers_.size() + 1; }
+
+  /** Lock all extra workers (the main worker must already be locked). This is used
+   *  for changes that touch nodes in different workers (links).
+   */
+  void lock_workers() {
+    for (size_t i = 0; i < workers_.size(); ++i) workers_[i]->lock();
+  }
+
+  void unlock_workers() {
+    for (size_t i = workers_.size(); i > 0; --i) workers_[i - 1]->unlock();
+  }
+
   /** Used to access '/class' when rko objects are loaded. */
   ClassFinder *classes() { return classes_; }
 
+  /** Parse a patch file in bulk load mode. Returns the load report (see end_bulk_load). */
+  const Value load_file(const std::string &path);
+
+  /** Start bulk loading: nodes are created as usual but links are only stored
+   *  and connection sorting is delayed until end_bulk_load.
+   */
+  void begin_bulk_load();
+
+  /** Resolve all pending links in a single pass, sort connections and return
+   *  the load report {parse, links, sort, total} in [ms] with the number of
+   *  'created' and still 'pending' links.
+   */
+  const Value end_bulk_load();
+
+  /** Return true during a bulk load. */
+  bool bulk_loading() const { return bulk_loading_; }
+
+  /** Connection sorting batch (used during bulk loads, with the planet lock). */
+  SlotSortBatch *sort_batch() { return &sort_batch_; }
+
+  /** True if command front-ends should post method calls to the worker instead of
+   *  calling them with the worker lock (see TextCommand::set_async and '--async').
+   */
+  bool async_commands() const { return async_commands_; }
+
   /** Create/remove a link between two slots. */
   const Value link(const Value &val);
 
@@ -127,7 +179,96 @@ class Planet : public Root
   /** Calls 'inspect' on a node. */
   const Value inspect(const Value &val);
 
+  /** Get/set the number of workers. The number of workers can only grow.
+   */
+  const Value workers(const Value &val);
+
+  /** Get/set the SCHED_FIFO priority of the workers (0 = default). */
+  const Value worker_priority(const Value &val);
+
+  /** Get/set the cpus used by the workers: worker 'i' runs on cpus[i % size] ([] = no pinning). */
+  const Value worker_cpus(const Value &val);
+
+  /** Lock all current and future memory pages (mlockall). */
+  const Value worker_mlock(const Value &val);
+
+  /** Get/set the amount of stack [KB] touched by the workers on start. */
+  const Value worker_prefault(const Value &val);
+
+  /** Get/set deadline scheduling for all workers. */
+  const Value worker_deadline(const Value &val);
+
+  /** Get/set the number of frames processed by block nodes on each block tick. */
+  const Value worker_block_size(const Value &val);
+
+  /** Get/set the sample rate [Hz] of block nodes. */
+  const Value worker_block_rate(const Value &val);
+
+  /** Get/set the time [us] spent in a loop before looped nodes are deferred to the next one. */
+  const Value worker_budget(const Value &val);
+
+  /** Get/set shared Lua interpreters: Lua nodes created afterwards share one
+   *  interpreter per worker (each node has its own environment). The setting is
+   *  stored in LuaVM and applies to all planets in the process.
+   */
+  const Value lua_shared(const Value &val);
+
+  /** Get/set the directory where compiled Lua scripts are cached ("" = no cache).
+   *  Process-wide like lua_shared.
+   */
+  const Value lua_cache(const Value &val);
+
+  /** Return all worker settings in a hash (used by '/.inspect /rubyk/worker'). */
+  const Value worker_settings();
+
+  /** Enable/disable timing statistics in all workers. */
+  const Value stats_enable(const Value &val);
+
+  /** Clear statistics. */
+  const Value stats_reset(const Value &val);
+
+  /** Loop timing of all workers {count, last, average, max} [us]. */
+  const Value stats_loops(const Value &val);
+
+  /** Event lateness histogram of all workers. */
+  const Value stats_lateness(const Value &val);
+
+  /** Events per tick in all workers. */
+  const Value stats_events(const Value &val);
+
+  /** Time spent in each node. */
+  const Value stats_nodes(const Value &val);
+
+  /** Full report by worker id {"0":{...}, "1":{...}}. */
+  const Value stats_report(const Value &val);
+
+  /** Append a report to a file every few seconds: ["path", seconds]. Nil stops dumping. */
+  const Value stats_dump(const Value &val);
+
+  /** Store a report for the dump thread (posted by the dump thread, runs in the main worker). */
+  const Value stats_snapshot(const Value &val);
+
+  /** Profile of a node [inclusive us, exclusive us, calls] or of all nodes {url: [...]} (nil). */
+  const Value profile(const Value &val);
+
+  /** Enable/disable the call profiler in all workers. */
+  const Value profile_enable(const Value &val);
+
+  /** Clear profiles. */
+  const Value profile_reset(const Value &val);
+
+  /** Write call paths to a file (flamegraph "folded stacks" format). */
+  const Value profile_dump(const Value &val);
+
  private:
+  /** Create or remove a link once both ends exist (called with all workers locked). */
+  const Value change_link(Object *source, const Value &val);
+
+  /** Report of the last bulk load (see '/rubyk/load'). */
+  const Value load_report(const Value &val) {
+    return load_report_;
+  }
+
   /** Add a pending link. */
   const Value add_pending_link(const Value &val) {
     Value params;
@@ -147,9 +288,51 @@ class Planet : public Root
   /** Create base objects (public for testing, should not be used). */
   void init();
 
+  /** Read worker options from the command line and return the index of the first
+   *  argument that is not an option (file name).
+   */
+  int parse_options(int argc, char * argv[]);
+
+  /** Merge statistics from all workers (called with all workers locked). */
+  void merged_stats(WorkerStats *stats);
+
+  /** Stop the thread writing statistics. */
+  void stop_stats_dump();
+
+  /** Statistics dump thread. */
+  static void *stats_dump_thread(void *planet);
+
+  /** Create all pending links whose source and target exist (bulk load). */
+  const Value resolve_pending_links();
+
+  /** Apply current realtime settings to a worker. */
+  void configure_worker(Worker *worker, size_t id);
+
   std::list<Call>  pending_links_;        /**< List of pending connections waiting for variable assignements. */
   Worker worker_;
+  std::vector<Worker*> workers_;          /**< Extra workers (worker 'i' is at workers_[i-1]). */
   ClassFinder *classes_;
+  bool running_;                          /**< True once the workers have been started. */
+
+  /** Realtime settings (see '/rubyk/worker'). */
+  Value worker_cpus_;                     /**< List of cpu ids. */
+  bool memory_locked_;                    /**< True if mlockall succeeded. */
+  bool async_commands_;                   /**< Command front-ends post method calls. */
+
+  /** Statistics dump (see '/rubyk/stats/dump'). */
+  pthread_t stats_thread_;                /**< Thread writing reports. */
+  volatile bool stats_dumping_;           /**< The dump thread should continue. */
+  std::string stats_path_;                /**< File receiving reports (one json report per line). */
+  Real stats_interval_;                   /**< Seconds between two reports. */
+  pthread_mutex_t stats_mutex_;           /**< Protects the snapshot (never held with a worker lock held by the dump thread). */
+  std::string stats_snapshot_;            /**< Last report line written by stats_snapshot. */
+  size_t stats_snapshot_id_;              /**< Incremented on each snapshot. */
+
+  /** Bulk loading (see begin_bulk_load). */
+  bool bulk_loading_;                     /**< Links are stored without lookup. */
+  long long load_start_ns_;               /**< Start of the current bulk load. */
+  Value load_report_;                     /**< Timing of the last bulk load. */
+  SlotSortBatch sort_batch_;              /**< Delays connection sorting during bulk loads. */
 };
 
 #endif // _PLANET_H_
\ No newline at end of file
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "profiler.h"
+#include "node.h"
+
+#include <sys/time.h>
+#include <time.h>
+
+// Expected maximal call depth (deeper calls allocate).
+#define PROFILER_DEPTH 256
+
+Profiler::Frame::Frame(Node *node, Frame *parent) : node_(node), parent_(parent), inclusive_ns_(0), children_ns_(0), calls_(0) {
+  if (node) url_ = node->url();
+}
+
+Profiler::Frame::~Frame() {
+  std::vector<Frame*>::iterator it;
+  std::vector<Frame*>::iterator end = children_.end();
+  for (it = children_.begin(); it < end; ++it) delete *it;
+}
+
+Profiler::Profiler() : enabled_(false), reset_pending_(false) {
+  root_    = new Frame(NULL, NULL);
+  current_ = root_;
+  starts_.reserve(PROFILER_DEPTH);
+}
+
+Profiler::~Profiler() {
+  delete root_;
+}
+
+long long Profiler::now_ns() {
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_usec * 1000LL;
+#endif
+}
+
+void Profiler::enter(Node *node) {
+  Frame *frame = NULL;
+  std::vector<Frame*>::iterator it;
+  std::vector<Frame*>::iterator end = current_->children_.end();
+  for (it = current_->children_.begin(); it < end; ++it) {
+    if ((*it)->node_ == node) {
+      frame = *it;
+      break;
+    }
+  }
+
+  if (!frame) {
+    frame = new Frame(node, current_);
+    current_->children_.push_back(frame);
+  }
+
+  current_ = frame;
+  starts_.push_back(now_ns());
+}
+
+void Profiler::leave() {
+  long long elapsed = now_ns() - starts_.back();
+  starts_.pop_back();
+
+  current_->inclusive_ns_ += elapsed;
+  ++current_->calls_;
+  current_ = current_->parent_;
+  current_->children_ns_ += elapsed;
+
+  if (reset_pending_ && current_ == root_) reset();
+}
+
+void Profiler::reset() {
+  if (current_ != root_) {
+    reset_pending_ = true;
+    return;
+  }
+  delete root_;
+  root_ = new Frame(NULL, NULL);
+  current_ = root_;
+  reset_pending_ = false;
+}
+
+void Profiler::forget(Node *node) {
+  forget_frame(root_, node);
+}
+
+void Profiler::forget_frame(Frame *frame, Node *node) {
+  if (frame->node_ == node) frame->node_ = NULL;
+  std::vector<Frame*>::iterator it;
+  std::vector<Frame*>::iterator end = frame->children_.end();
+  for (it = frame->children_.begin(); it < end; ++it) forget_frame(*it, node);
+}
+
+void Profiler::collect(std::map<std::string, ProfileTotals> *totals) const {
+  std::vector<Frame*>::const_iterator it;
+  std::vector<Frame*>::const_iterator end = root_->children_.end();
+  for (it = root_->children_.begin(); it < end; ++it) collect_frame(*it, totals);
+}
+
+void Profiler::collect_frame(const Frame *frame, std::map<std::string, ProfileTotals> *totals) {
+  // recursive calls of the same node count their time more than once in 'inclusive'
+  ProfileTotals &total = (*totals)[frame->url_];
+  total.inclusive_ns_ += frame->inclusive_ns_;
+  total.exclusive_ns_ += frame->inclusive_ns_ - frame->children_ns_;
+  total.calls_        += frame->calls_;
+
+  std::vector<Frame*>::const_iterator it;
+  std::vector<Frame*>::const_iterator end = frame->children_.end();
+  for (it = frame->children_.begin(); it < end; ++it) collect_frame(*it, totals);
+}
+
+void Profiler::write_folded(std::ostream &out, const std::string &prefix) const {
+  std::vector<Frame*>::const_iterator it;
+  std::vector<Frame*>::const_iterator end = root_->children_.end();
+  for (it = root_->children_.begin(); it < end; ++it) write_frame(*it, out, prefix);
+}
+
+void Profiler::write_frame(const Frame *frame, std::ostream &out, const std::string &path) {
+  std::string frame_path(path);
+  frame_path.append(";").append(frame->url_);
+
+  long long exclusive_us = (frame->inclusive_ns_ - frame->children_ns_) / 1000;
+  if (exclusive_us > 0) out << frame_path << " " << exclusive_us << "\n";
+
+  std::vector<Frame*>::const_iterator it;
+  std::vector<Frame*>::const_iterator end = frame->children_.end();
+  for (it = frame->children_.begin(); it < end; ++it) write_frame(*it, out, frame_path);
+}
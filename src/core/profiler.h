@@ -0,0 +1,119 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_PROFILER_H_
+#define RUBYK_SRC_CORE_PROFILER_H_
+#include "oscit.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Node;
+
+/** Time and call count of a node (all call paths merged). */
+struct ProfileTotals
+{
+  ProfileTotals() : inclusive_ns_(0), exclusive_ns_(0), calls_(0) {}
+
+  long long inclusive_ns_;  /**< Time in the node and in the nodes it called. */
+  long long exclusive_ns_;  /**< Time in the node only. */
+  size_t    calls_;         /**< Number of calls. */
+};
+
+/** Per worker call profiler.
+ *
+ *  The worker (and outlets) call 'enter' before giving control to a node (event, loop
+ *  bang, inlet) and 'leave' when it returns. Every distinct call path gets a frame in a
+ *  trie so that we can compute inclusive/exclusive times and write flamegraph compatible
+ *  "folded stacks".
+ *
+ *  The profiler is only used by its worker's thread (or with the worker lock).
+ */
+class Profiler
+{
+ public:
+  Profiler();
+
+  ~Profiler();
+
+  bool enabled() const { return enabled_; }
+
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+
+  /** A node starts running (called from a node or from the worker). */
+  void enter(Node *node);
+
+  /** The node entered last returns. */
+  void leave();
+
+  /** Remove all frames (delayed until no node is running). */
+  void reset();
+
+  /** A node dies: keep its times but never match it again. */
+  void forget(Node *node);
+
+  /** Add the times of every node (by url) to 'totals'. */
+  void collect(std::map<std::string, ProfileTotals> *totals) const;
+
+  /** Write one line per call path: "prefix;url1;url2 exclusive_us". */
+  void write_folded(std::ostream &out, const std::string &prefix) const;
+
+  /** Monotonic time in [ns]. */
+  static long long now_ns();
+
+ private:
+  struct Frame {
+    Frame(Node *node, Frame *parent);
+    ~Frame();
+
+    Node *node_;                   /**< Running node (NULL once the node is dead). */
+    std::string url_;              /**< Node url when the frame was created. */
+    Frame *parent_;
+    std::vector<Frame*> children_;
+    long long inclusive_ns_;
+    long long children_ns_;        /**< Time spent in children frames. */
+    size_t calls_;
+  };
+
+  static void collect_frame(const Frame *frame, std::map<std::string, ProfileTotals> *totals);
+
+  static void write_frame(const Frame *frame, std::ostream &out, const std::string &path);
+
+  static void forget_frame(Frame *frame, Node *node);
+
+  bool enabled_;
+  bool reset_pending_;             /**< Reset requested while nodes were running. */
+  Frame *root_;                    /**< Worker (not a node). */
+  Frame *current_;                 /**< Frame of the running node. */
+  std::vector<long long> starts_;  /**< Start time of each running frame. */
+};
+
+#endif // RUBYK_SRC_CORE_PROFILER_H_
@@ -38,6 +38,7 @@
 
 #include "class.h"
 #include "class_finder.h"
+#include "static_object.h"
 #include "new_method.h"
 #include "text_command.h"
 #include "lua_script.h"
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_SIGNAL_BLOCK_H_
+#define RUBYK_SRC_CORE_SIGNAL_BLOCK_H_
+#include "oscit.h"
+
+#include <vector>
+
+/** A contiguous view on 'frames' sample frames of 'channels' values each, stored
+ *  frame by frame (same layout as a matrix with one row per frame).
+ *
+ *  Blocks are sent through outlets with Outlet::send_block: inlets with a block
+ *  method receive the whole block in a single call, other inlets receive each
+ *  frame in order (sample accurate).
+ */
+class SignalBlock
+{
+ public:
+  SignalBlock() : data_(NULL), frames_(0), channels_(0) {}
+
+  SignalBlock(Real *data, size_t frames, size_t channels) : data_(data), frames_(frames), channels_(channels) {}
+
+  /** Pointer to the first value of frame 'i'. */
+  inline Real *frame(size_t i) const {
+    return data_ + i * channels_;
+  }
+
+  /** Value of 'channel' in frame 'i'. */
+  inline Real &at(size_t i, size_t channel) const {
+    return data_[i * channels_ + channel];
+  }
+
+  /** Total number of values in the block. */
+  inline size_t size() const {
+    return frames_ * channels_;
+  }
+
+  /** Frame 'i' as a Value: a Real for mono blocks, a list of channels otherwise. */
+  const Value frame_value(size_t i) const {
+    if (channels_ == 1) return Value(data_[i]);
+    Value res;
+    Real *values = frame(i);
+    for (size_t c = 0; c < channels_; ++c) res.push_back(Value(values[c]));
+    return res;
+  }
+
+  Real   *data_;      /**< First value of the first frame. */
+  size_t  frames_;    /**< Number of frames in the block. */
+  size_t  channels_;  /**< Number of values per frame. */
+};
+
+/** A SignalBlock owning its storage. Storage is kept when the buffer is resized to
+ *  a smaller or equal size so that nodes can reuse it on every tick.
+ */
+class SignalBuffer : public SignalBlock
+{
+ public:
+  SignalBuffer() {}
+
+  SignalBuffer(size_t frames, size_t channels) {
+    resize(frames, channels);
+  }
+
+  /** Change the block dimensions (content is not preserved). */
+  void resize(size_t frames, size_t channels) {
+    if (storage_.size() < frames * channels) storage_.resize(frames * channels);
+    data_     = storage_.empty() ? NULL : &storage_[0];
+    frames_   = frames;
+    channels_ = channels;
+  }
+
+ private:
+  // data_ points into storage_: no copies
+  SignalBuffer(const SignalBuffer &other);
+  SignalBuffer &operator=(const SignalBuffer &other);
+
+  std::vector<Real> storage_;
+};
+
+#endif // RUBYK_SRC_CORE_SIGNAL_BLOCK_H_
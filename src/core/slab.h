@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_SLAB_H_
+#define RUBYK_SRC_CORE_SLAB_H_
+
+#include <cstddef>
+#include <new>
+#include <pthread.h>
+
+// Number of objects allocated at once when a slab is empty.
+#define SLAB_CHUNK_SIZE 256
+
+/** Free list allocator for objects of type T (used through T::operator new/delete).
+ *
+ *  Memory is taken from the system in chunks of SLAB_CHUNK_SIZE objects and recycled
+ *  but never given back. Objects created one after the other (the slots of a node)
+ *  end up next to each other. Subclasses with a different size use the global
+ *  operator new.
+ */
+template <class T>
+class SlabAllocator
+{
+ public:
+  static void *allocate(size_t size) {
+    if (size != sizeof(T)) return ::operator new(size);
+
+    pthread_mutex_lock(&sMutex);
+      if (!sFree) grow();
+      Block *block = sFree;
+      sFree = block->next_;
+      ++sUsed;
+    pthread_mutex_unlock(&sMutex);
+    return block;
+  }
+
+  static void release(void *ptr, size_t size) {
+    if (!ptr) return;
+    if (size != sizeof(T)) {
+      ::operator delete(ptr);
+      return;
+    }
+
+    Block *block = (Block*)ptr;
+    pthread_mutex_lock(&sMutex);
+      block->next_ = sFree;
+      sFree = block;
+      --sUsed;
+    pthread_mutex_unlock(&sMutex);
+  }
+
+  /** Number of objects currently allocated in the slab. */
+  static size_t used() { return sUsed; }
+
+  /** Number of objects the slab can hold without growing. */
+  static size_t capacity() { return sCapacity; }
+
+ private:
+  union Block {
+    Block *next_;
+    double align_;
+    char   data_[sizeof(T)];
+  };
+
+  static void grow() {
+    Block *chunk = (Block*)::operator new(sizeof(Block) * SLAB_CHUNK_SIZE);
+    for (size_t i = 0; i < SLAB_CHUNK_SIZE - 1; ++i) {
+      chunk[i].next_ = &chunk[i + 1];
+    }
+    chunk[SLAB_CHUNK_SIZE - 1].next_ = sFree;
+    sFree = chunk;
+    sCapacity += SLAB_CHUNK_SIZE;
+  }
+
+  static pthread_mutex_t sMutex;
+  static Block *sFree;
+  static size_t sUsed;
+  static size_t sCapacity;
+};
+
+// statically initialized: the slab can be used during static initialization
+template <class T> pthread_mutex_t SlabAllocator<T>::sMutex = PTHREAD_MUTEX_INITIALIZER;
+template <class T> typename SlabAllocator<T>::Block *SlabAllocator<T>::sFree = NULL;
+template <class T> size_t SlabAllocator<T>::sUsed = 0;
+template <class T> size_t SlabAllocator<T>::sCapacity = 0;
+
+#endif // RUBYK_SRC_CORE_SLAB_H_
@@ -31,13 +31,53 @@
 #include "node.h"
 #include "planet.h"
 
+#include <algorithm>
+
+SlotSortBatch::~SlotSortBatch() {
+  for (size_t i = 0; i < pending_.size(); ++i) {
+    if (pending_[i]) pending_[i]->pending_batch_ = NULL;
+  }
+}
+
+void SlotSortBatch::add(Slot *slot) {
+  if (slot->pending_batch_) return;
+  slot->pending_batch_ = this;
+  slot->pending_index_ = pending_.size();
+  pending_.push_back(slot);
+}
+
+void SlotSortBatch::remove(Slot *slot) {
+  if (slot->pending_batch_ != this) return;
+  if (slot->pending_index_ < pending_.size() && pending_[slot->pending_index_] == slot) {
+    pending_[slot->pending_index_] = NULL;
+  }
+  slot->pending_batch_ = NULL;
+}
+
+void SlotSortBatch::end() {
+  if (depth_ == 0 || --depth_ > 0) return;
+
+  std::vector<Slot*> pending;
+  pending.swap(pending_);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (pending[i]) pending[i]->pending_batch_ = NULL;
+  }
+  // sort and rebuild outlet plans
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (pending[i]) pending[i]->sort_connections();
+  }
+}
+
 Slot::~Slot() {
   // remove connections with other slots
-  Slot * s;
-  while( connections_.get(&s)) {
+  while (!connections_.empty()) {
+    Slot *s = connections_.back();
+    connections_.pop_back();
+    connected_.erase(s);
     s->remove_connection(this);
-    connections_.pop();
   }
+
+  if (pending_batch_) pending_batch_->remove(this);
 }
 
 
@@ -58,6 +98,65 @@ void Slot::disconnect(Slot *slot) {
 }
     
 
+bool Slot::sends_before(Slot *a, Slot *b) {
+  if (a->node_ == b->node_) {
+    // same node, largest position first
+    return a->id_ > b->id_;
+  }
+  Real a_position = a->node_->trigger_position();
+  Real b_position = b->node_->trigger_position();
+  if (a_position != b_position) {
+    // different node, greatest trigger position first
+    return a_position > b_position;
+  }
+  // same trigger position: same order on every run
+  const std::string &a_url = a->node_->url();
+  const std::string &b_url = b->node_->url();
+  if (a_url != b_url) return a_url < b_url;
+  // nodes outside of a tree
+  return a->node_ < b->node_;
+}
+
+SlotSortBatch *Slot::open_sort_batch() {
+  Worker *worker = node_ ? node_->worker() : NULL;
+  Planet *planet = worker ? TYPE_CAST(Planet, worker->root()) : NULL;
+  if (!planet || !planet->sort_batch()->is_open()) return NULL;
+  return planet->sort_batch();
+}
+
+void Slot::sort_connections() {
+  SlotSortBatch *batch = open_sort_batch();
+  if (batch) {
+    batch->add(this);
+  } else {
+    std::stable_sort(connections_.begin(), connections_.end(), sends_before);
+    connections_changed();
+  }
+}
+
+void Slot::update_connection(Slot *slot) {
+  SlotSortBatch *batch = open_sort_batch();
+  if (batch) {
+    batch->add(this);
+    return;
+  }
+
+  std::vector<Slot*>::iterator it = std::find(connections_.begin(), connections_.end(), slot);
+  if (it == connections_.end()) return;
+  // rotate the entry to its new place (only the entries in between move)
+  std::vector<Slot*>::iterator next = it + 1;
+  if (next != connections_.end() && sends_before(*next, slot)) {
+    std::vector<Slot*>::iterator place = std::lower_bound(next, connections_.end(), slot, sends_before);
+    std::rotate(it, next, place);
+  } else if (it != connections_.begin() && sends_before(slot, *(it - 1))) {
+    std::vector<Slot*>::iterator place = std::upper_bound(connections_.begin(), it, slot, sends_before);
+    std::rotate(place, it, next);
+  } else {
+    return; // still in place
+  }
+  connections_changed();
+}
+
 /** Sort slots by rightmost node and rightmost position in the same node. */
 bool Slot::operator>= (const Slot &slot) const {
   if (node_ == slot.node_) {
@@ -77,8 +176,18 @@ bool Slot::add_connection(Slot *slot) {
   if ((kind_of(Inlet)        && can_receive(slot->type()[0])) ||
       (slot->kind_of(Inlet)  && slot->can_receive(type()[0]))) {
     // same type signature or inlet receiving any type
-    // OrderedList makes sure the link is not created again if it already exists.
-    connections_.push(slot); 
+    // the link is not created again if it already exists.
+    if (connected_.insert(slot).second) {
+      SlotSortBatch *batch = open_sort_batch();
+      if (batch) {
+        // plans are rebuilt when the batch ends
+        connections_.push_back(slot);
+        batch->add(this);
+      } else {
+        connections_.insert(std::lower_bound(connections_.begin(), connections_.end(), slot, sends_before), slot);
+        connections_changed();
+      }
+    }
     return true;
   } else {
     return false;
@@ -86,7 +195,20 @@ bool Slot::add_connection(Slot *slot) {
 }
 
 void Slot::remove_connection(Slot * slot) {
-  connections_.remove(slot);
+  if (!connected_.erase(slot)) return;
+  std::vector<Slot*>::iterator it;
+  if (pending_batch_) {
+    // not sorted yet
+    it = std::find(connections_.begin(), connections_.end(), slot);
+  } else {
+    it = std::lower_bound(connections_.begin(), connections_.end(), slot, sends_before);
+    if (it != connections_.end() && *it != slot) {
+      // sort key changed without update_connection
+      it = std::find(connections_.begin(), connections_.end(), slot);
+    }
+  }
+  if (it != connections_.end()) connections_.erase(it);
+  connections_changed();
 }
 
 const Value Slot::change_link(unsigned char operation, const Value &val) {
@@ -29,10 +29,49 @@
 
 #ifndef _SLOT_H_
 #define _SLOT_H_
-#include "ordered_list.h"
 #include "oscit.h"
+#include "slab.h"
+
+#include <set>
+#include <vector>
 
 class Node;
+class Slot;
+
+/** Delays connection sorting while many slots change at once (loading a patch). Each
+ *  slot whose connections changed order is then sorted once when the batch ends.
+ *
+ *  A batch belongs to a Planet (see Planet::sort_batch) and is used with the planet lock
+ *  (main worker lock) held, like all changes to links and trigger positions.
+ */
+class SlotSortBatch
+{
+ public:
+  SlotSortBatch() : depth_(0) {}
+
+  ~SlotSortBatch();
+
+  /** Start delaying sorts (nested calls are counted). */
+  void begin() {
+    ++depth_;
+  }
+
+  /** Sort all the slots whose connections changed order during the batch. */
+  void end();
+
+  /** Return true between begin and the matching end. */
+  bool is_open() const { return depth_ > 0; }
+
+  /** Sort a slot when the batch ends. */
+  void add(Slot *slot);
+
+  /** Forget a slot (slot is dying). */
+  void remove(Slot *slot);
+
+ private:
+  size_t depth_;               /**< Depth of begin calls. */
+  std::vector<Slot*> pending_; /**< Slots to sort at the end of the batch (NULL = removed). */
+};
 
 /** Inlets and outlets of nodes are Slots. 
   * 
@@ -44,15 +83,15 @@ class Slot : public Object
 public:
   TYPED("Object.Slot")
   
-  Slot(Node *node, const Value &type) : Object(type), node_(node) {
+  Slot(Node *node, const Value &type) : Object(type), node_(node), pending_batch_(NULL), pending_index_(0) {
     create_methods();
   }
   
-  Slot(Node *node, const char *name, const Value &type) : Object(name, type), node_(node) {
+  Slot(Node *node, const char *name, const Value &type) : Object(name, type), node_(node), pending_batch_(NULL), pending_index_(0) {
     create_methods();
   }
   
-  Slot(Node *node, const std::string &name, const Value &type) : Object(name, type), node_(node) {
+  Slot(Node *node, const std::string &name, const Value &type) : Object(name, type), node_(node), pending_batch_(NULL), pending_index_(0) {
     create_methods();
   }
   
@@ -84,11 +123,9 @@ public:
   
   /** List all links. */
   const Value list(const Value &val) {
-    LinkedList<Slot*> * iterator = connections_.begin();
     Value res;
-    while(iterator) {
-      res.push_back(iterator->obj->url());
-      iterator = iterator->next;
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      res.push_back(connections_[i]->url());
     }
     return res;
   }
@@ -98,28 +135,47 @@ public:
   
   inline Node *node() { return node_; }
   
+  /** Return true if 'a' receives values before 'b': rightmost node first (highest trigger
+   *  position) and rightmost position in the same node. Nodes with the same trigger
+   *  position are ordered by url so that the order does not change between runs.
+   */
+  static bool sends_before(Slot *a, Slot *b);
+  
   /** Connections pointing out of this slot should reorder (an inlet id changed or its node changed position). */
-  void sort_connections() {
-    connections_.sort();
-  }
+  void sort_connections();
 
-  void sort_incoming_connections() {
-    LinkedList<Slot*> * iterator = connections_.begin();
+  /** A single connected slot moved (id or trigger position changed): move it to its new
+   *  place. The entry is found with a linear scan (its previous sort key is not known)
+   *  and moved with a single rotation.
+   */
+  void update_connection(Slot *slot);
 
-    while(iterator) {
-      iterator->obj->sort_connections();
-      iterator = iterator->next;
+  /** Reorder our position in the connections of all the slots connected to us. */
+  void sort_incoming_connections() {
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      connections_[i]->update_connection(this);
     }
   }
 
+  /** Return true if this slot is connected to 'slot'. */
+  inline bool is_connected_to(Slot *slot) const {
+    return connected_.find(slot) != connected_.end();
+  }
+
 protected:
   /** Make a one-way connection to another slot. 
-    * Create a connection if the type of the other slot is compatible. */
+    * Create a connection if the type of the other slot is compatible.
+    * During a sort batch, the connection is appended and connections_changed is only
+    * called when the batch ends: values sent before that do not use the new link. */
   bool add_connection(Slot *slot);
   
-  /** Remove a one-way connection to another slot. */
+  /** Remove a one-way connection to another slot (binary search, the following entries
+    * are shifted). */
   void remove_connection(Slot *slot);
   
+  /** Called when connections are added, removed or sorted. */
+  virtual void connections_changed() {}
+  
   /** Create 'list' method. */
   void create_methods() {
     adopt(new TMethod<Slot, &Slot::list>(this, "list", NilIO("Return a list of linked urls.")));
@@ -136,8 +192,19 @@ protected:
    */
   int id_;
   
-  OrderedList<Slot*> connections_; /**< connections are kept sorted, so that we always send values to inlets
+  std::vector<Slot*> connections_; /**< connections are kept sorted, so that we always send values to inlets
     that are rightmost (less important, no bang) first. */
+  
+  std::set<Slot*> connected_;      /**< Same content as connections_ for fast membership checks. */
+  
+ private:
+  friend class SlotSortBatch;
+
+  /** Return the sort batch of our planet if it is open (NULL otherwise). */
+  SlotSortBatch *open_sort_batch();
+
+  SlotSortBatch *pending_batch_;    /**< Batch that will sort our connections (NULL if none). */
+  size_t pending_index_;            /**< Position in the pending list of that batch. */
 };
 
 #endif
\ No newline at end of file
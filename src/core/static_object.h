@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_STATIC_OBJECT_H_
+#define RUBYK_SRC_CORE_STATIC_OBJECT_H_
+
+#include <map>
+#include <string>
+
+class Planet;
+
+typedef void (*object_init_t)(Planet &planet);
+
+/** Registry of the objects compiled into the executable (RUBYK_STATIC_OBJECTS build).
+ *
+ *  Each object declares its init function with RUBYK_INIT(ClassName). In a normal build
+ *  this expands to the 'init' symbol looked up by ClassFinder after dlopen. In a static
+ *  build, it registers the function here at static initialization time and ClassFinder
+ *  calls it without opening any library (libraries are still used for classes that are
+ *  not registered).
+ */
+class StaticObject
+{
+ public:
+  StaticObject(const char *class_name, object_init_t init) {
+    objects()[class_name] = init;
+  }
+
+  /** Return the init function for a class or NULL if it is not compiled in. */
+  static object_init_t find(const std::string &class_name) {
+    std::map<std::string, object_init_t>::const_iterator it = objects().find(class_name);
+    return it == objects().end() ? NULL : it->second;
+  }
+
+  /** All registered objects by class name. */
+  static std::map<std::string, object_init_t> &objects() {
+    // function static: registration happens during static initialization
+    static std::map<std::string, object_init_t> sObjects;
+    return sObjects;
+  }
+};
+
+#ifdef RUBYK_STATIC_OBJECTS
+#define RUBYK_INIT(klass) static void klass ## _init(Planet &planet);                        \
+                          static StaticObject klass ## _static_object(#klass, klass ## _init); \
+                          static void klass ## _init(Planet &planet)
+#else
+#define RUBYK_INIT(klass) extern "C" void init(Planet &planet)
+#endif
+
+#endif // RUBYK_SRC_CORE_STATIC_OBJECT_H_
@@ -32,11 +32,16 @@
 #include "node.h"
 
 #include <pthread.h>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <sstream>
 
 #define MAX_TOKEN_SIZE 2048
 
+// Size of the blocks read by parse_file.
+#define TEXT_COMMAND_CHUNK_SIZE 16384
+
 class Planet;
 
 class TextCommand : public Command {
@@ -58,11 +63,23 @@ public:
 
   /** Ragel parser. */
   void parse(const char *string) {
-    parse(std::string(string));
+    parse(string, strlen(string));
   }
 
   /** Ragel parser. */
-  void parse(const std::string &string);
+  void parse(const std::string &string) {
+    parse(string.data(), string.size());
+  }
+
+  /** Ragel parser. Parse a chunk of text: commands and tokens can span
+   *  several chunks (parser state and tokens are kept between calls).
+   */
+  void parse(const char *data, size_t length);
+
+  /** Parse a file by chunks of TEXT_COMMAND_CHUNK_SIZE bytes without loading it
+   *  in memory. Returns false if the file could not be opened or read.
+   */
+  bool parse_file(const char *path);
 
   /** Used for testing. */
   void set_input(std::istream &input) { input_ = &input; }
@@ -76,6 +93,14 @@ public:
   /** Print command results back. */
   void set_verbose() { silent_ = false; }
 
+  /** Post method calls to the worker's queue instead of executing them with the
+   *  worker lock. Results are not printed back in this mode. Node creation, links
+   *  and commands such as 'lib' or 'quit' still run directly and only these take
+   *  the lock (the listen loop does not hold it while parsing). They first execute
+   *  the calls still waiting in the queue.
+   */
+  void set_async(bool async) { async_ = async; }
+
   void print_result(const Value &res) {
     if (!silent_) {
       if (res.is_string()) {
@@ -161,10 +186,32 @@ protected:
   /** Execute a command or inspect instance. */
   void execute_command();
 
+  /** Call url directly or post the call to the worker (async mode). */
+  const Value call_or_post(const std::string &url, const Value &params);
+
+  /** Take the lock for a synchronous operation (async mode only: otherwise the
+   *  listen loop already holds it). Calls posted before are executed first so that
+   *  commands run in the order they were typed.
+   */
+  void lock_sync();
+
+  void unlock_sync() {
+    if (async_) unlock();
+  }
+
   /** Read a line from input stream. */
-  virtual bool getline(char **buffer, size_t size) {
+  virtual bool getline(char **buffer) {
+    return read_input_line(buffer);
+  }
+
+  /** Read a full line from input_ into line_ (no length limit). */
+  bool read_input_line(char **buffer) {
     if (input_->eof()) return false;
-    input_->getline(*buffer, size);
+    std::string line;
+    std::getline(*input_, line);
+    line_.assign(line.begin(), line.end());
+    line_.push_back('\0');
+    *buffer = &line_[0];
     return true;
   }
 
@@ -188,8 +235,10 @@ protected:
   /** IO management. */
   std::istream *input_;
   std::ostream *output_;
+  std::vector<char> line_; /**< Storage for the last line read from input_. */
 
   bool silent_;
+  bool async_;  /**< Post method calls to the worker instead of calling them directly. */
 };
 
 #ifdef USE_READLINE
@@ -219,7 +268,7 @@ public:
     write_history(history_path().c_str());
   }
 
-  virtual bool getline(char **buffer, size_t size) {
+  virtual bool getline(char **buffer) {
     *buffer = readline("> "); // FIXME: this would not work if input is not stdin...
     return *buffer != NULL;
   }
@@ -252,11 +301,9 @@ public:
   CommandLine(std::istream &input, std::ostream &output) : TextCommand(input, output) {}
   CommandLine() {}
 
-  virtual bool getline(char ** buffer, size_t size) {
+  virtual bool getline(char ** buffer) {
     *output_ << "> ";
-    if (input_->eof()) return false;
-    input_->getline(*buffer, size);
-    return true;
+    return read_input_line(buffer);
   }
 };
 
@@ -30,6 +30,10 @@
 #include "text_command.h"
 #include "rubyk.h"
 
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
 //#define DEBUG_PARSER
 
 #ifdef DEBUG_PARSER
@@ -47,37 +51,57 @@ void TextCommand::initialize() {
   int cs;
 
   silent_     = false;
+  async_      = false;
   clear();
   %% write init;
   current_state_ = cs;
 }
 
 void TextCommand::listen() {
-  char buffer[1024];
-  char *line = buffer; //  when not using readline, use 'buffer' for storage
+  char *line = NULL; // storage is owned by getline (see freeline)
 
   if (!silent_) *output_ << "# Welcome to rubyk !\n# \n";
 
   clear();
 
   thread_ready();
-  while(should_run() && getline(&line, 1023)) {
-    lock();
+  while(should_run() && getline(&line)) {
+    // in async mode, the lock is only taken for synchronous operations (see lock_sync)
+    if (!async_) lock();
       parse(line);
       parse("\n");
       if (should_run()) saveline(line); // command was not a 'quit'
       freeline(line);
-    unlock();
+    if (!async_) unlock();
+  }
+}
+
+bool TextCommand::parse_file(const char *path) {
+  char buffer[TEXT_COMMAND_CHUNK_SIZE];
+  ssize_t count;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  // tokens and parser state are kept between chunks
+  while ( (count = read(fd, buffer, TEXT_COMMAND_CHUNK_SIZE)) != 0 ) {
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    parse(buffer, count);
   }
+  close(fd);
+  parse("\n"); // last line without newline
+  return count == 0;
 }
 
-void TextCommand::parse(const std::string &string) {
-  const char *p  = string.data();     // data pointer
-  const char *pe = p + string.size(); // past end
+void TextCommand::parse(const char *data, size_t length) {
+  const char *p  = data;              // data pointer
+  const char *pe = p + length;        // past end
   const char *eof = NULL;             // FIXME: this should be set to 'pe' on the last string block...
   int cs = current_state_;            // restore machine state
 
-  DEBUG(printf("parse:\"%s\"\n",string.c_str()));
+  DEBUG(printf("parse:\"%.*s\"\n", (int)length, data));
 
   %%{
     action a {
@@ -135,7 +159,8 @@ void TextCommand::parse(const std::string &string) {
     action error {
       fhold; // move back one char
       char error_buffer[10];
-      snprintf(error_buffer, 9, "%s", p);
+      const char *from = p < data ? data : p; // error on the first byte of a chunk
+      snprintf(error_buffer, 9, "%.*s", (int)(pe - from), from); // chunks are not zero terminated
       *output_ << "# Syntax error near '" << error_buffer << "'." << std::endl;
       clear();
       fgoto eat_line; // eat the rest of the line and continue parsing
@@ -203,8 +228,8 @@ void TextCommand::set_from_token(std::string &string) {
   DEBUG(if (&string == &var_)   std::cout << "[var " << token_ << "]" << std::endl);
   DEBUG(if (&string == &class_) std::cout << "[cla " << token_ << "]" << std::endl);
 
-  string = token_;
-  token_ = "";
+  string.assign(token_);
+  token_.clear(); // keep buffer
 }
 
 void TextCommand::create_instance() {
@@ -220,6 +245,7 @@ void TextCommand::create_instance() {
   list.push_back(var_);
   list.push_back(params);
 
+  lock_sync();
   Value res = root_->call(std::string(CLASS_URL).append("/").append(class_).append("/new"), list, this);
 
   Value links;
@@ -235,6 +261,7 @@ void TextCommand::create_instance() {
   } else if (!silent_) {
     print_result(res);
   }
+  unlock_sync();
 }
 
 void TextCommand::change_link(char op) {
@@ -261,7 +288,10 @@ void TextCommand::change_link(char op) {
     list.push_back(std::string(to_node_).append("/in/").append(to_port_));
   }
 
-  print_result(root_->call(LINK_URL, list, this));
+  lock_sync();
+    Value res = root_->call(LINK_URL, list, this);
+  unlock_sync();
+  print_result(res);
 }
 
 void TextCommand::execute_method() {
@@ -274,6 +304,7 @@ void TextCommand::execute_method() {
 
   if (method_ == "set") {
     // TODO: should 'set' live in normal tree space ?
+    lock_sync();
     Object *target = root_->object_at(var_);
     if (target) {
       target->lock();
@@ -282,10 +313,11 @@ void TextCommand::execute_method() {
     } else {
       res = ErrorValue(NOT_FOUND_ERROR, var_);
     }
+    unlock_sync();
   } else {
     if (method_ == "b") method_ = "bang";
     var_.append("/").append(method_);
-    res = root_->call(var_, params, this);
+    res = call_or_post(var_, params);
   }
   print_result(res);
 }
@@ -295,7 +327,9 @@ void TextCommand::execute_class_method() {
   Value params = Value(Json(parameter_string_));
 
   DEBUG(std::cout << "CLASS_METHOD " << std::string(CLASS_URL).append("/").append(class_).append("/").append(method_) << "(" << params << ")" << std::endl);
-  res = root_->call(std::string(CLASS_URL).append("/").append(class_).append("/").append(method_), params, this);
+  lock_sync();
+    res = root_->call(std::string(CLASS_URL).append("/").append(class_).append("/").append(method_), params, this);
+  unlock_sync();
   print_result(res);
 }
 
@@ -305,24 +339,50 @@ void TextCommand::execute_command() {
 
   DEBUG(std::cout << "CMD " << method_ << "(" << params << ")" << std::endl);
   if (method_ == "lib") {
-    res = root_->call(LIB_URL, params, this);
+    lock_sync();
+      res = root_->call(LIB_URL, params, this);
+    unlock_sync();
   } else if (method_ == "quit" || method_ == "q") {
     quit();  // Readline won't quit with a SIGTERM (see doc/prototypes/term_readline.cpp) so
              // we have to use quit() instead of kill().
 
-    res = root_->call(QUIT_URL, gNilValue, this);
+    lock_sync();
+      res = root_->call(QUIT_URL, gNilValue, this);
+    unlock_sync();
   } else {
     names_to_urls();
-    res = root_->call(method_, params, this);
+    res = call_or_post(method_, params);
   }
   print_result(res);
 }
 
+void TextCommand::lock_sync() {
+  if (!async_) return;
+  lock();
+  // execute posted calls before this command
+  Planet *planet = TYPE_CAST(Planet, root_);
+  if (planet) planet->worker()->flush_calls();
+}
+
+const Value TextCommand::call_or_post(const std::string &url, const Value &params) {
+  if (async_) {
+    Planet *planet = TYPE_CAST(Planet, root_);
+    if (planet) {
+      planet->worker()->post(url, params);
+      return gNilValue;
+    }
+  }
+  lock_sync();
+    Value res = root_->call(url, params, this);
+  unlock_sync();
+  return res;
+}
+
 void TextCommand::clear() {
-  token_      = "";
-  var_        = "";
-  class_      = "";
-  parameter_string_ = "";
-  from_port_  = "";
-  to_port_    = "";
+  token_.clear();
+  var_.clear();
+  class_.clear();
+  parameter_string_.clear();
+  from_port_.clear();
+  to_port_.clear();
 }
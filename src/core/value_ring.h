@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_VALUE_RING_H_
+#define RUBYK_SRC_CORE_VALUE_RING_H_
+#include "oscit.h"
+
+#include <vector>
+
+class Inlet;
+
+// Default number of values waiting between two workers.
+#define VALUE_RING_SIZE 1024
+
+/** A value sent to an inlet living in another worker. */
+struct RingMessage
+{
+  RingMessage() : inlet_(NULL) {}
+
+  Inlet *inlet_;  /**< Destination (NULL if the message was cancelled). */
+  Value  value_;  /**< Sent value (deep copy, owned by the ring until received). */
+};
+
+/** Single producer / single consumer ring buffer used for outlet connections
+ *  that cross workers.
+ *
+ *  There is one ring per (source worker, destination worker) pair. The producer is
+ *  whoever holds the source worker's lock, the consumer is the destination worker
+ *  (with its own lock). Neither side ever waits on the other: a full ring drops the
+ *  value and counts it.
+ *
+ *  Values are deep copied on push and released by the consumer so that reference
+ *  counts are never shared between two threads.
+ */
+class ValueRing
+{
+ public:
+  ValueRing(size_t size = VALUE_RING_SIZE) : messages_(size + 1), head_(0), tail_(0), dropped_(0), copies_(0) {}
+
+  /** Add a value for the given inlet (producer side). Return false if the ring is full. */
+  bool push(Inlet *inlet, const Value &value) {
+    size_t head = head_;
+    size_t next = head + 1 == messages_.size() ? 0 : head + 1;
+    if (next == tail_) {
+      ++dropped_;
+      return false;
+    }
+    RingMessage &message = messages_[head];
+    message.inlet_ = inlet;
+    message.value_.copy(value);
+    ++copies_;
+    __sync_synchronize(); // message must be written before it is published
+    head_ = next;
+    return true;
+  }
+
+  /** Get the next message or NULL if the ring is empty (consumer side).
+   *  The message stays valid until 'release' is called.
+   */
+  RingMessage *front() {
+    if (tail_ == head_) return NULL;
+    __sync_synchronize();
+    return &messages_[tail_];
+  }
+
+  /** Free the front message and make room for the producer (consumer side). */
+  void release() {
+    RingMessage &message = messages_[tail_];
+    message.inlet_ = NULL;
+    message.value_.set_nil();
+    __sync_synchronize();
+    tail_ = tail_ + 1 == messages_.size() ? 0 : tail_ + 1;
+  }
+
+  /** Cancel pending messages whose inlet matches the predicate (consumer side: the
+   *  caller must hold the lock of the worker reading this ring).
+   */
+  template<class T>
+  void cancel_if(const T &predicate) {
+    size_t head = head_;
+    __sync_synchronize();
+    for (size_t i = tail_; i != head; i = (i + 1 == messages_.size() ? 0 : i + 1)) {
+      if (messages_[i].inlet_ && predicate(messages_[i].inlet_)) messages_[i].inlet_ = NULL;
+    }
+  }
+
+  /** Number of values dropped because the ring was full. */
+  size_t dropped() const { return dropped_; }
+
+  /** Number of deep copies made by push. */
+  size_t copies() const { return copies_; }
+
+ private:
+  std::vector<RingMessage> messages_; /**< Storage (one slot is always free). */
+  volatile size_t head_;              /**< Next slot to write (producer). */
+  volatile size_t tail_;              /**< Next slot to read (consumer). */
+  size_t dropped_;                    /**< Values lost because the ring was full (producer). */
+  size_t copies_;                     /**< Values copied into the ring (producer). */
+};
+
+#endif // RUBYK_SRC_CORE_VALUE_RING_H_
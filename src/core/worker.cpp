@@ -29,66 +29,448 @@
 
 #include "worker.h"
 #include "node.h"
+#include "inlet.h"
 
+#include <alloca.h>
+#include <cstring>    // strerror, memset
+#include <sched.h>
+#include <unistd.h>   // sysconf
+
+void Worker::init() {
+  pthread_mutex_init(&wake_mutex_, NULL);
+#ifdef __APPLE__
+  // no pthread_condattr_setclock: wait_for_deadline uses a relative timeout
+  pthread_cond_init(&wake_cond_, NULL);
+#else
+  // deadlines are on the monotonic clock (not affected by NTP or clock changes)
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&wake_cond_, &attr);
+  pthread_condattr_destroy(&attr);
+#endif
+  for (size_t i = 0; i < WORKER_LOOP_PRIORITIES; ++i) loop_cursor_[i] = 0;
+  freeing_node_ = NULL;
+}
+
+void Worker::set_worker_count(size_t count) {
+  // remove inboxes from workers that do not exist anymore
+  while (inboxes_.size() > count) {
+    delete inboxes_.back();
+    inboxes_.pop_back();
+  }
+
+  while (inboxes_.size() < count) {
+    inboxes_.push_back(inboxes_.size() == id_ ? NULL : new ValueRing);
+  }
+}
+
+size_t Worker::dropped_values() const {
+  size_t dropped = 0;
+  std::vector<ValueRing*>::const_iterator it;
+  std::vector<ValueRing*>::const_iterator end = inboxes_.end();
+  for(it = inboxes_.begin(); it < end; it++) {
+    if (*it) dropped += (*it)->dropped();
+  }
+  return dropped;
+}
+
+size_t Worker::copied_values() const {
+  size_t copies = 0;
+  std::vector<ValueRing*>::const_iterator it;
+  std::vector<ValueRing*>::const_iterator end = inboxes_.end();
+  for(it = inboxes_.begin(); it < end; it++) {
+    if (*it) copies += (*it)->copies();
+  }
+  return copies;
+}
+
+/** Used to find messages sent to a given node. */
+struct InletOfNode {
+  InletOfNode(Node *node) : node_(node) {}
+  bool operator()(Inlet *inlet) const { return inlet->node() == node_; }
+  Node *node_;
+};
+
+void Worker::free_messages_for(Node *node) {
+  std::vector<ValueRing*>::iterator it;
+  std::vector<ValueRing*>::iterator end = inboxes_.end();
+  for(it = inboxes_.begin(); it < end; it++) {
+    if (*it) (*it)->cancel_if(InletOfNode(node));
+  }
+}
+
+void Worker::free_events_for(Node *node) {
+  std::vector<Event*> events;
+  Event * e;
+  // detach the node's events before triggering anything
+  while( (e = events_queue_.first_event_for(node)) ) {
+    events_queue_.remove(e);
+    events.push_back(e);
+  }
+
+  Node *previous = freeing_node_; // a forced event can delete another node
+  freeing_node_ = node;
+    for (size_t i = 0; i < events.size(); ++i) {
+      if (events[i]->forced_) events[i]->trigger();
+      delete events[i];
+    }
+  freeing_node_ = previous;
+}
+
+void Worker::transfer_events(Node *node, Worker *target) {
+  Event * e;
+  while( (e = events_queue_.first_event_for(node)) ) {
+    events_queue_.remove(e);
+    // the event must be stored in the target's pool (pools are not thread safe)
+    target->events_queue_.push(e->clone(&target->event_pool_));
+    delete e;
+  }
+  if (target->deadline_mode_) target->wake_up();
+}
 
 void Worker::register_looped_node(Node *node) {
-  free_looped_node(node);
-  looped_nodes_.push_back(node);
+  if (node->loop_index_ != NODE_NOT_LOOPED) return; // already looped
+  std::vector<Node*> &nodes = looped_nodes_[node->loop_priority_];
+  node->loop_index_ = nodes.size();
+  nodes.push_back(node);
+  ++looped_count_;
+  if (deadline_mode_ && !poll_) {
+    poll_ = true;
+    wake_up();
+  }
 }
 
 
 void Worker::miss_event(const Event *event) {
+  if (stats_.enabled()) stats_.event_missed();
   fprintf(stderr, "Not registering event from %s: (trigger too soon: %li [ms]).\n",
                   event->node()->do_inspect().str().c_str(),
                   (event->when_ - current_time_));
 }
 
-void Worker::free_looped_node(Node *node) {  
-  std::deque<Node*>::iterator it;
-  std::deque<Node*>::iterator end = looped_nodes_.end();
-  for(it = looped_nodes_.begin(); it < end; it++) {
-    if (*it == node) {
-      looped_nodes_.erase(it);
-      break;
-    }
-  }
+void Worker::free_looped_node(Node *node) {
+  std::vector<Node*> &nodes = looped_nodes_[node->loop_priority_];
+  size_t index = node->loop_index_;
+  if (index >= nodes.size() || nodes[index] != node) return; // not looped here
+
+  Node *last = nodes.back();
+  nodes[index] = last;
+  last->loop_index_ = index;
+  nodes.pop_back();
+  node->loop_index_ = NODE_NOT_LOOPED;
+  --looped_count_;
+}
+
+void Worker::register_block_node(Node *node) {
+  if (node->block_index_ != NODE_NOT_LOOPED) return;
+  node->block_index_ = block_nodes_.size();
+  block_nodes_.push_back(node);
+  if (deadline_mode_) wake_up();
+}
+
+void Worker::free_block_node(Node *node) {
+  size_t index = node->block_index_;
+  if (index >= block_nodes_.size() || block_nodes_[index] != node) return;
+
+  Node *last = block_nodes_.back();
+  block_nodes_[index] = last;
+  last->block_index_ = index;
+  block_nodes_.pop_back();
+  node->block_index_ = NODE_NOT_LOOPED;
 }
 
 void Worker::start_worker(Thread *thread) {
   thread->thread_ready();
   high_priority();
+  apply_settings();
   while (loop())
     ;
 }
 
-void Worker::pop_events() {
+void Worker::apply_settings() {
+  // settings are written by commands holding the worker lock
+  lock();
+    settings_changed_ = false;
+    int priority    = priority_;
+    int cpu         = cpu_;
+    size_t prefault = prefault_stack_;
+  unlock();
+
+  if (priority != applied_priority_) {
+    struct sched_param param;
+    int policy;
+    if (!default_saved_) {
+      // remember the scheduling set by high_priority so that priority 0 can restore it
+      pthread_getschedparam(pthread_self(), &default_policy_, &param);
+      default_sched_priority_ = param.sched_priority;
+      default_saved_ = true;
+    }
+    if (priority > 0) {
+      policy = SCHED_FIFO;
+      param.sched_priority = priority;
+    } else {
+      policy = default_policy_;
+      param.sched_priority = default_sched_priority_;
+    }
+    int error = pthread_setschedparam(pthread_self(), policy, &param);
+    if (error) {
+      fprintf(stderr, "Worker %lu: could not set SCHED_FIFO priority %i (%s).\n", (unsigned long)id_, priority, strerror(error));
+    } else {
+      applied_priority_ = priority > 0 ? priority : 0;
+    }
+  }
+
+  if (cpu != applied_cpu_) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (cpu >= 0) {
+      CPU_SET(cpu, &cpus);
+    } else {
+      // unpin: allow all cpus
+      long count = sysconf(_SC_NPROCESSORS_CONF);
+      for (long i = 0; i < count && i < CPU_SETSIZE; ++i) CPU_SET(i, &cpus);
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error) {
+      fprintf(stderr, "Worker %lu: could not pin thread to cpu %i (%s).\n", (unsigned long)id_, cpu, strerror(error));
+    } else {
+      applied_cpu_ = cpu >= 0 ? cpu : -1;
+    }
+#else
+    if (cpu >= 0) fprintf(stderr, "Worker %lu: cpu pinning is not supported on this platform.\n", (unsigned long)id_);
+#endif
+  }
+
+  if (prefault > applied_prefault_) {
+    // touch the pages now so that they are mapped (and locked with mlockall)
+    size_t kilobytes = prefault > max_prefault_stack() ? max_prefault_stack() : prefault;
+    volatile unsigned char *stack = (volatile unsigned char *)alloca(kilobytes * 1024);
+    memset((void*)stack, 0, kilobytes * 1024);
+    applied_prefault_ = kilobytes;
+  }
+}
+
+size_t Worker::max_prefault_stack() {
+  pthread_attr_t attr;
+  size_t size = 0;
+  pthread_attr_init(&attr);
+  pthread_attr_getstacksize(&attr, &size);
+  pthread_attr_destroy(&attr);
+  // leave the other half to the loop
+  return size / 1024 / 2;
+}
+
+size_t Worker::pop_events() {
   Event * e;
+  size_t count = 0;
   time_t realTime = current_time_;
   while( events_queue_.get(&e) && realTime >= e->when_) {
+    events_queue_.pop(); // pop first: trigger can register new events
     current_time_ = e->when_;
-    e->trigger();
+    if (stats_.enabled()) {
+      stats_.event_lateness(realTime - e->when_);
+      long long start = WorkerStats::now_us();
+      trigger_event(e);
+      stats_.node_time(e->node_, WorkerStats::now_us() - start);
+    } else {
+      trigger_event(e);
+    }
     delete e;
-    events_queue_.pop();
+    ++count;
   }
   current_time_ = realTime;
+  return count;
 }
 
 void Worker::pop_all_events() {
   Event * e;
   while( events_queue_.get(&e)) {
+    events_queue_.pop();
     current_time_ = e->when_;
     if (e->forced_) e->trigger();
     delete e;
+  }
+}
+
+void Worker::free_all_events() {
+  Event * e;
+  while( events_queue_.get(&e)) {
     events_queue_.pop();
+    delete e;
+  }
+}
+
+void Worker::process_calls() {
+  QueuedCall *call;
+  size_t count = 0;
+  while ( (max_calls_per_loop_ == 0 || count < max_calls_per_loop_) && (call = call_queue_.pop()) ) {
+    execute_call(call);
+    ++count;
+  }
+  // more calls are waiting: do not sleep
+  if (deadline_mode_ && max_calls_per_loop_ && count == max_calls_per_loop_) wake_up();
+}
+
+void Worker::execute_call(QueuedCall *call) {
+  Value res = root_->call(call->url_, call->param_);
+  if (res.is_error()) {
+    fprintf(stderr, "Posted call to '%s' failed: %s\n", call->url_.c_str(), res.error_message().c_str());
   }
+  call_pool_.recycle(call);
 }
 
-void Worker::trigger_loop_events() {
-  std::deque<Node *>::iterator it;
-  std::deque<Node *>::iterator end = looped_nodes_.end();
-  for(it = looped_nodes_.begin(); it < end; it++) {
-    (*it)->bang(gNilValue);
+inline void Worker::bang_looped(Node *node) {
+  if (profiler_.enabled()) {
+    profiler_.enter(node);
+      node->bang(gNilValue);
+    profiler_.leave();
+  } else {
+    node->bang(gNilValue);
   }
 }
 
+void Worker::process_inboxes() {
+  RingMessage *message;
+  std::vector<ValueRing*>::iterator it;
+  std::vector<ValueRing*>::iterator end = inboxes_.end();
+  for(it = inboxes_.begin(); it < end; it++) {
+    if (!*it) continue;
+    while ( (message = (*it)->front()) ) {
+      if (message->inlet_) {
+        if (profiler_.enabled()) {
+          profiler_.enter(message->inlet_->node());
+            message->inlet_->receive(message->value_);
+          profiler_.leave();
+        } else {
+          message->inlet_->receive(message->value_);
+        }
+      }
+      (*it)->release();
+    }
+  }
+}
 
+void Worker::trigger_loop_events(long long loop_start) {
+  if (!looped_count_) return;
+  ++loop_count_;
+
+  long long deadline = loop_budget_us_ ? loop_start + loop_budget_us_ : 0;
+  size_t deferred = 0;
+  for (size_t priority = 0; priority < WORKER_LOOP_PRIORITIES; ++priority) {
+    if (!looped_nodes_[priority].empty()) deferred += trigger_looped_nodes(priority, deadline);
+  }
+  if (deferred) stats_.loop_deferred(deferred);
+}
+
+size_t Worker::trigger_looped_nodes(size_t priority, long long deadline) {
+  std::vector<Node*> &nodes = looped_nodes_[priority];
+  size_t remaining = nodes.size();
+  size_t i = loop_cursor_[priority];
+  bool banged = false;
+  Node *node;
+  long long start = stats_.enabled() ? WorkerStats::now_us() : 0;
+  long long now;
+
+  while (remaining && !nodes.empty()) {
+    if (i >= nodes.size()) i = 0;
+    node = nodes[i];
+    if (node->loop_divisor_ == 1 || loop_count_ % node->loop_divisor_ == 0) {
+      if (banged && deadline && WorkerStats::now_us() >= deadline) break;
+      bang_looped(node);
+      banged = true;
+      if (start) {
+        now = WorkerStats::now_us();
+        stats_.node_time(node, now - start);
+        start = now;
+      }
+    }
+    // a node removed during bang is replaced by the last one: look at the same position again
+    if (i < nodes.size() && nodes[i] == node) ++i;
+    --remaining;
+  }
+  // deferred nodes are the first to be banged on next loop
+  loop_cursor_[priority] = i;
+  return remaining;
+}
+
+
+
+
+void Worker::trigger_block_ticks() {
+  if (block_nodes_.empty() || !block_size_ || block_rate_ <= 0) return;
+
+  Real period = block_size_ * ONE_SECOND / block_rate_;
+  size_t ticks = 0;
+  Node *node;
+
+  while (next_block_time_ <= current_time_) {
+    if (ticks == WORKER_MAX_BLOCKS_PER_LOOP) {
+      // too late: drop the missing blocks instead of running in bursts
+      next_block_time_ = current_time_ + period;
+      break;
+    }
+    for(size_t i = 0; i < block_nodes_.size(); ) {
+      node = block_nodes_[i];
+      if (profiler_.enabled()) {
+        profiler_.enter(node);
+          node->process_block(block_size_);
+        profiler_.leave();
+      } else {
+        node->process_block(block_size_);
+      }
+      if (i < block_nodes_.size() && block_nodes_[i] == node) ++i;
+    }
+    next_block_time_ += period;
+    ++ticks;
+  }
+}
+
+void Worker::set_next_deadline() {
+  Event *e;
+  pthread_mutex_lock(&wake_mutex_);
+    poll_ = looped_count_ > 0;
+    sleep_until_ns_ = time_to_ns(current_time_ + WORKER_MAX_IDLE_MS);
+    if (events_queue_.get(&e) && time_to_ns(e->when_) < sleep_until_ns_) {
+      sleep_until_ns_ = time_to_ns(e->when_);
+    }
+    if (!block_nodes_.empty() && block_size_ && block_rate_ > 0 && time_to_ns(next_block_time_) < sleep_until_ns_) {
+      // block ticks keep their sub-millisecond phase
+      sleep_until_ns_ = time_to_ns(next_block_time_);
+    }
+  pthread_mutex_unlock(&wake_mutex_);
+}
+
+void Worker::wake_up_before(time_t when) {
+  pthread_mutex_lock(&wake_mutex_);
+    if (time_to_ns(when) < sleep_until_ns_) {
+      sleep_until_ns_ = time_to_ns(when);
+      pthread_cond_signal(&wake_cond_);
+    }
+  pthread_mutex_unlock(&wake_mutex_);
+}
+
+void Worker::wait_for_deadline() {
+  struct timespec deadline;
+  long long remaining;
+
+  pthread_mutex_lock(&wake_mutex_);
+    while (!wake_pending_ && should_run_) {
+      remaining = sleep_until_ns_ - Profiler::now_ns();
+      if (remaining <= 0) break;
+
+#ifdef __APPLE__
+      deadline.tv_sec  = remaining / 1000000000LL;
+      deadline.tv_nsec = remaining % 1000000000LL;
+      pthread_cond_timedwait_relative_np(&wake_cond_, &wake_mutex_, &deadline);
+#else
+      // absolute time on the condition's clock (CLOCK_MONOTONIC like Profiler::now_ns)
+      deadline.tv_sec  = sleep_until_ns_ / 1000000000LL;
+      deadline.tv_nsec = sleep_until_ns_ % 1000000000LL;
+      pthread_cond_timedwait(&wake_cond_, &wake_mutex_, &deadline);
+#endif
+    }
+    wake_pending_ = false;
+  pthread_mutex_unlock(&wake_mutex_);
+}
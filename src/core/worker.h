@@ -35,30 +35,74 @@ Structure of a running planet:
 The Planet is an oscit::Root:
 Root   <- Planet
 
-It contains a single Worker that is passed to subnodes as context
-Planet <>--- Worker
+It contains a main Worker that is passed to subnodes as context and
+optional extra workers (one thread each) for nodes with an 'affinity':
+Planet <>--- Worker (id 0)
+       <>--- Worker (id 1..n)
+
+Values sent through connections between two workers go through a ValueRing.
 */
-#include "ordered_list.h"
 #include "event.h"
+#include "event_queue.h"
+#include "call_queue.h"
+#include "value_ring.h"
+#include "worker_stats.h"
+#include "profiler.h"
 
 #include "oscit/mutex.h"
 
 #include <csignal>
 #include <fstream>
 #include <queue>
+#include <vector>
+#include <pthread.h>
 
 // is 2 [ms] too long ? Testing needed.
 // 0.01 = 10 [us] = 0.00001 [s] = 100'000 [Hz] = 100 [kHz]
 #define WORKER_SLEEP_MS 0.01
+// In deadline mode, an idle worker still wakes up this often to check if it should quit.
+#define WORKER_MAX_IDLE_MS 50
+// Maximal number of posted calls executed in a single loop (0 = no limit).
+#define WORKER_MAX_CALLS_PER_LOOP 64
+// Looped nodes are banged by priority class, high priority first.
+#define WORKER_LOOP_PRIORITIES 3
+#define LOOP_PRIORITY_HIGH 0
+#define LOOP_PRIORITY_NORMAL 1
+#define LOOP_PRIORITY_LOW 2
+// Maximal number of block ticks executed in a single loop when the worker is late.
+#define WORKER_MAX_BLOCKS_PER_LOOP 8
 #define ONE_SECOND 1000.0
 #define ONE_MINUTE (60.0*ONE_SECOND)
 
 class Worker : public Thread {
 public:
-  Worker(Root *root) : current_time_(0), root_(root) {}
+  Worker(Root *root) : current_time_(0), root_(root), id_(0), in_loop_(false), looped_count_(0), loop_count_(0), loop_budget_us_(0),
+                       block_size_(0), block_rate_(0), next_block_time_(0), max_calls_per_loop_(WORKER_MAX_CALLS_PER_LOOP),
+                       deadline_mode_(false), poll_(true), wake_pending_(false), sleep_until_ns_(0),
+                       settings_changed_(false), priority_(0), cpu_(-1), prefault_stack_(0),
+                       applied_priority_(0), applied_cpu_(-1), applied_prefault_(0), default_saved_(false) {
+    time_origin_ns_ = Profiler::now_ns();
+    init();
+  }
+
+  /** Create an extra worker sharing the time reference of 'reference' (logical times
+   *  are the same in all workers).
+   */
+  Worker(Root *root, const Worker *reference, size_t id) : current_time_(0), root_(root), id_(id), in_loop_(false), time_origin_ns_(reference->time_origin_ns_),
+                       looped_count_(0), loop_count_(0), loop_budget_us_(reference->loop_budget_us_),
+                       block_size_(reference->block_size_), block_rate_(reference->block_rate_), next_block_time_(0), max_calls_per_loop_(WORKER_MAX_CALLS_PER_LOOP),
+                       deadline_mode_(reference->deadline_mode_), poll_(true), wake_pending_(false), sleep_until_ns_(0),
+                       settings_changed_(false), priority_(0), cpu_(-1), prefault_stack_(0),
+                       applied_priority_(0), applied_cpu_(-1), applied_prefault_(0), default_saved_(false) {
+    init();
+  }
 
   virtual ~Worker() {
     kill();
+    free_all_events();
+    set_worker_count(0);
+    pthread_cond_destroy(&wake_cond_);
+    pthread_mutex_destroy(&wake_mutex_);
   }
 
   /** Run until quit (through a command or signal). */
@@ -69,65 +113,253 @@ public:
   /** Set if the planet should be running (only used with direct loop control). */
   void should_run(bool should_run) {
     should_run_ = should_run;
+    wake_up();
+  }
+
+  /** When deadline mode is on, the worker sleeps until the next event in the queue instead
+   *  of polling every WORKER_SLEEP_MS. Polling is still used as long as there are looped nodes.
+   */
+  void set_deadline_mode(bool deadline_mode) {
+    deadline_mode_ = deadline_mode;
+    wake_up();
+  }
+
+  bool deadline_mode() const { return deadline_mode_; }
+
+  /** Interrupt the worker's sleep (deadline mode). Commands should call this after they
+   *  changed something the worker needs to see right away.
+   */
+  void wake_up() {
+    pthread_mutex_lock(&wake_mutex_);
+      wake_pending_ = true;
+      pthread_cond_signal(&wake_cond_);
+    pthread_mutex_unlock(&wake_mutex_);
   }
 
   Root *root() { return root_; }
 
+  /** Realtime priority (SCHED_FIFO, 1-99). 0 restores the default 'high_priority' setting.
+   *  Like all realtime settings, this is applied by the worker thread at the beginning
+   *  of its next loop. Realtime settings must be changed with the worker lock once the
+   *  worker is running.
+   */
+  void set_priority(int priority) {
+    priority_ = priority;
+    settings_changed_ = true;
+  }
+
+  int priority() const { return priority_; }
+
+  /** Pin the worker thread to a cpu (-1 = any cpu, only supported on linux). */
+  void set_cpu(int cpu) {
+    cpu_ = cpu;
+    settings_changed_ = true;
+  }
+
+  int cpu() const { return cpu_; }
+
+  /** Touch this amount of stack [KB] so that page faults happen now and not during processing
+   *  (used with mlockall). Return false if the value is larger than max_prefault_stack.
+   */
+  bool set_prefault_stack(size_t kilobytes) {
+    if (kilobytes > max_prefault_stack()) return false;
+    prefault_stack_ = kilobytes;
+    settings_changed_ = true;
+    return true;
+  }
+
+  size_t prefault_stack() const { return prefault_stack_; }
+
+  /** Largest stack prefault [KB]: half of the default thread stack size. */
+  static size_t max_prefault_stack();
+
+  /** Priority in use by the worker thread (0 if SCHED_FIFO was not set or failed). */
+  int applied_priority() const { return applied_priority_; }
+
+  /** Cpu the worker thread is pinned to (-1 if not pinned or if pinning failed). */
+  int applied_cpu() const { return applied_cpu_; }
+
+  /** Stack prefaulted by the worker thread [KB]. */
+  size_t applied_prefault() const { return applied_prefault_; }
+
+  /** Position of the worker in the planet (0 = main worker). */
+  size_t id() const { return id_; }
+
+  /** Create one inbox per other worker. Must be called with the worker lock. */
+  void set_worker_count(size_t count);
+
+  /** Send a value to an inlet living in this worker from another worker. The caller
+   *  must hold the lock of 'source'. The value is received during our next loop.
+   */
+  void post_value(const Worker *source, Inlet *inlet, const Value &val) {
+    ValueRing *inbox = source->id_ < inboxes_.size() ? inboxes_[source->id_] : NULL;
+    if (inbox && inbox->push(inlet, val) && deadline_mode_) wake_up();
+  }
+
+  /** Number of values lost because an inbox was full. */
+  size_t dropped_values() const;
+
+  /** Number of values deep copied to reach this worker (values crossing workers). */
+  size_t copied_values() const;
+
+  /** Forget values waiting for the inlets of a node (node is dying or moving). Must be
+   *  called with this worker locked (inboxes are read in our loop).
+   */
+  void free_messages_for(Node *node);
+
+  /** Move the events of a node to another worker. Both workers must be locked. */
+  void transfer_events(Node *node, Worker *target);
+
+  /** Current logical time [ms]. In the loop, this is the time of the event being triggered.
+   *  Outside the loop (commands holding the worker lock), current_time_ is first refreshed
+   *  from the clock: a worker in deadline mode can sleep for WORKER_MAX_IDLE_MS.
+   */
+  time_t now() {
+    if (!in_loop_) current_time_ = clock_time();
+    return current_time_;
+  }
+
   /** Add an event to the event queue. The server is responsible for deleting the event. */
   void register_event(Event *event) {
-    if (event->when_ < current_time_ + WORKER_SLEEP_MS) {
+    now();
+    if (freeing_node_ && event->node() == freeing_node_) {
+      // node is dying (re-registration from a forced event)
+      delete event;
+    } else if (event->when_ < current_time_ + WORKER_SLEEP_MS) {
       miss_event(event);
+      delete event;
     } else if (should_run_ || event->forced_) {
       events_queue_.push(event); // do not accept new events while we are trying to quit.
+      if (deadline_mode_) wake_up_before(event->when_);
+    } else {
+      delete event;
     }
   }
 
+  /** Call a method on a node at a given time. The parameter is shared with the caller (no copy). */
   template<class T, void(T::*Tmethod)(const Value&)>
-  void register_event(time_t when, T *receiver, const Value &parameter) {
-    register_event(new TEvent<T, Tmethod>(when, receiver, parameter));
+  void register_event(time_t when, T *receiver, const Value &parameter, bool forced = false) {
+    register_event(new(&event_pool_) TEvent<T, Tmethod>(when, receiver, parameter, forced));
+  }
+
+  /** Storage for events. Use with 'new(worker->event_pool()) BangEvent(...)'. */
+  EventPool *event_pool() { return &event_pool_; }
+
+  /** Queue a call to be executed by the worker at the beginning of its next loop.
+   *  This method can be used from any thread: it never blocks on the worker lock.
+   *  The parameter is deep copied.
+   */
+  void post(const std::string &url, const Value &param) {
+    call_queue_.push(call_pool_.get(url, param));
+    if (deadline_mode_) wake_up();
+  }
+
+  /** Execute all posted calls now. The caller must hold the worker lock (the worker
+   *  thread only reads the queue with the lock). Used by commands that mix posted and
+   *  direct calls to keep them in order.
+   */
+  void flush_calls() {
+    QueuedCall *call;
+    while ( (call = call_queue_.pop()) ) execute_call(call);
+  }
+
+  /** Timing statistics (read with the worker lock). */
+  WorkerStats *stats() { return &stats_; }
+
+  /** Call profiler (read with the worker lock). */
+  Profiler *profiler() { return &profiler_; }
+
+  /** Limit the number of posted calls executed in a single loop so that a burst of
+   *  commands cannot delay timed events for too long (0 = no limit).
+   */
+  void set_max_calls_per_loop(size_t max_calls) {
+    max_calls_per_loop_ = max_calls;
   }
 
-  /** Register a node as needing constant bangs. */
+  /** Limit the time spent in a loop [us]: timed events always run, then looped nodes
+   *  are banged by priority until the budget is consumed (0 = no limit). Nodes that did
+   *  not fit are banged first on the next loop and every priority class bangs at least
+   *  one node per loop so that no node starves.
+   */
+  void set_loop_budget(long long budget_us) {
+    loop_budget_us_ = budget_us < 0 ? 0 : budget_us;
+  }
+
+  long long loop_budget() const { return loop_budget_us_; }
+
+  /** Number of frames produced by block nodes on each block tick (0 = no block ticks). */
+  void set_block_size(size_t frames) {
+    block_size_ = frames;
+    next_block_time_ = current_time_;
+  }
+
+  size_t block_size() const { return block_size_; }
+
+  /** Sample rate of block nodes [Hz]: a block tick happens every block_size / rate seconds. */
+  void set_block_rate(Real rate) {
+    block_rate_ = rate < 0 ? 0 : rate;
+    next_block_time_ = current_time_;
+  }
+
+  Real block_rate() const { return block_rate_; }
+
+  /** Register a node to be called with process_block on every block tick (O(1)). */
+  void register_block_node(Node *node);
+
+  /** Stop block ticks for a node (O(1), the last node takes its place). */
+  void free_block_node(Node *node);
+
+  /** Register a node as needing constant bangs (O(1)). */
   void register_looped_node(Node *node);
 
-  /** Remove a node from the 'constant bang' list. */
+  /** Remove a node from the 'constant bang' list (O(1), the last node takes its place). */
   void free_looped_node(Node *node);
 
-  /** Remove all events related to a given node before the node dies. */
-  void free_events_for(Node *node) {
-    Event * e;
-    LinkedList<Event*> * it   = events_queue_.begin();
-
-    // find element
-    while(it) {
-      e = it->obj;
-      if (e->uses_receiver(node)) {
-        if (e->forced_) e->trigger();
-        it = events_queue_.remove(e);
-      } else
-        it = it->next;
-    }
-  }
+  /** Remove all events related to a given node before the node dies. Forced
+   *  events are triggered: events they register for the same node are dropped.
+   */
+  void free_events_for(Node *node);
 
   /** Run a single step, returns false when quit loop should stop (quit).
    *  This method can be used if you want to handle the loop yourself.
    */
   inline bool loop() {
-    struct timespec sleeper;
-    sleeper.tv_sec  = 0;
-    sleeper.tv_nsec = WORKER_SLEEP_MS * 1000000; // 1'000'000
+    if (settings_changed_) apply_settings();
+
+    if (deadline_mode_ && !poll_) {
+      // sleep until next event or until someone wakes us up
+      wait_for_deadline();
+    } else {
+      struct timespec sleeper;
+      sleeper.tv_sec  = 0;
+      sleeper.tv_nsec = WORKER_SLEEP_MS * 1000000; // 1'000'000
+      nanosleep(&sleeper, NULL);
+    }
 
-    // FIXME: only if no loop events ?
-    // FIXME: set sleeper time depending on next events ? what about commands that insert new events ?
-    nanosleep(&sleeper, NULL);
     lock();
-      current_time_ = time_ref_.elapsed();
+      in_loop_ = true;
+      current_time_ = clock_time();
+      long long loop_start = (stats_.enabled() || loop_budget_us_) ? WorkerStats::now_us() : 0;
+
+      // execute calls posted by commands
+      process_calls();
+
+      // receive values sent by other workers
+      process_inboxes();
+
+      // trigger events in the queue (timed events go before looped nodes)
+      size_t event_count = pop_events();
+
+      // run block nodes at their fixed rate
+      trigger_block_ticks();
 
       // execute events that must occur on each loop (io operations)
-      trigger_loop_events();
+      trigger_loop_events(loop_start);
+
+      if (loop_start && stats_.enabled()) stats_.loop_done(WorkerStats::now_us() - loop_start, event_count);
 
-      // trigger events in the queue
-      pop_events();
+      if (deadline_mode_) set_next_deadline();
+      in_loop_ = false;
     unlock(); // ok, others can do things while we sleep
 
     return should_run_;
@@ -145,30 +377,143 @@ public:
   void start_worker(Thread *thread);
 
   /** Realtime related stuff. */
+  /** Set priority, cpu and prefault the stack (runs in the worker thread).
+   */
+  void apply_settings();
+
   /** Method executed when an Event is registering too fast.
    */
   void miss_event(const Event *event);
 
-  /** Trigger events with a time older or equal to the current time. */
-  void pop_events ();
+  /** Trigger events with a time older or equal to the current time. Return the number of
+   *  triggered events.
+   */
+  size_t pop_events ();
 
   /** Empty events queue. */
   void pop_all_events ();
 
-  /** Trigger loop events. These are typically the IO 'read/write' of the IO nodes. */
-  void trigger_loop_events ();
+  /** Delete all events without triggering them. */
+  void free_all_events ();
+
+  /** Trigger loop events. These are typically the IO 'read/write' of the IO nodes.
+   *  'loop_start' is the time [us] at which the loop started (used for the loop budget).
+   */
+  void trigger_loop_events(long long loop_start);
+
+  /** Call process_block on block nodes for every block period elapsed since the last
+   *  tick (at most WORKER_MAX_BLOCKS_PER_LOOP, late ticks are dropped after that).
+   */
+  void trigger_block_ticks();
+
+  /** Bang the looped nodes of a priority class, starting at 'cursor'. Stops when the
+   *  deadline [us] is reached (after banging at least one node) and returns the number
+   *  of nodes deferred to the next loop.
+   */
+  size_t trigger_looped_nodes(size_t priority, long long deadline);
+
+  /** Trigger a single event (with profiling). */
+  inline void trigger_event(Event *e) {
+    if (profiler_.enabled()) {
+      profiler_.enter(e->node_);
+        e->trigger();
+      profiler_.leave();
+    } else {
+      e->trigger();
+    }
+  }
+
+  /** Bang a looped node (with profiling). */
+  inline void bang_looped(Node *node);
+
+  /** Execute calls posted by other threads. */
+  void process_calls ();
+
+  /** Execute a posted call and recycle it. */
+  void execute_call(QueuedCall *call);
+
+  /** Deliver values sent by other workers. */
+  void process_inboxes ();
+
+  /** Compute when the worker should wake up next (deadline mode, called with worker lock). */
+  void set_next_deadline();
+
+  /** Make sure the worker wakes up before the given time (deadline mode). */
+  void wake_up_before(time_t when);
+
+  /** Sleep until 'sleep_until_ns_' or until woken up by 'wake_up' (deadline mode). */
+  void wait_for_deadline();
+
+  /** Logical time [ms] read from the monotonic clock. */
+  time_t clock_time() const {
+    return (time_t)((Profiler::now_ns() - time_origin_ns_) / 1000000);
+  }
+
+  /** Monotonic time [ns] of a logical time [ms]. */
+  long long time_to_ns(Real when) const {
+    return time_origin_ns_ + (long long)(when * 1000000.0);
+  }
 
   Root *root_;                              /**< Root tree. */
 
-  /** Time reference. All times are [ms] from this reference.
-   * It's the worker's birthdate !
+  size_t id_;                               /**< Position in the planet's workers (0 = main). */
+
+  bool in_loop_;                            /**< The worker thread is in loop (current_time_ is the logical time). */
+
+  /** Time reference: monotonic clock [ns] at the worker's birthdate. All
+   * logical times are [ms] from this reference.
    */
-  TimeRef time_ref_;
+  long long time_origin_ns_;
 
   /** Events ! */
-  OrderedList<Event*>     events_queue_;    /**< Ordered event list. */
-  std::deque<Node*>       looped_nodes_;    /**< List of methods to call on every loop. */
-
+  EventPool               event_pool_;      /**< Storage for events (must outlive events_queue_ content). */
+  EventQueue              events_queue_;    /**< Ordered event list. */
+  std::vector<Node*>      looped_nodes_[WORKER_LOOP_PRIORITIES]; /**< Nodes to bang on every loop by priority (each node knows its index). */
+  size_t                  loop_cursor_[WORKER_LOOP_PRIORITIES];  /**< First node to bang in each priority class (round-robin). */
+  size_t                  looped_count_;    /**< Total number of looped nodes. */
+  size_t                  loop_count_;      /**< Number of loops with looped nodes (for loop divisors). */
+  long long               loop_budget_us_;  /**< Maximal time spent in a loop before deferring looped nodes (0 = no limit). */
+  Node                   *freeing_node_;    /**< Node whose events are being freed (new events for it are dropped). */
+
+  /** Block processing. */
+  std::vector<Node*>      block_nodes_;     /**< Nodes ticked with process_block (each node knows its index). */
+  size_t                  block_size_;      /**< Frames per block tick (0 = no block ticks). */
+  Real                    block_rate_;      /**< Frames per second. */
+  Real                    next_block_time_; /**< Logical time of the next block tick [ms]. */
+
+  /** Calls posted by commands. */
+  CallQueue               call_queue_;      /**< Lock-free queue filled by command threads. */
+  CallPool                call_pool_;       /**< Executed calls waiting for reuse. */
+  size_t                  max_calls_per_loop_; /**< Maximal number of calls executed in a loop. */
+
+  /** Values from other workers. */
+  std::vector<ValueRing*> inboxes_;         /**< One ring per source worker (indexed by id, NULL for ourself). */
+
+  /** Deadline scheduling. */
+  bool            deadline_mode_;           /**< Sleep until next event instead of polling. */
+  bool            poll_;                    /**< Looped nodes need polling: do not use deadline. */
+  bool            wake_pending_;            /**< Someone asked the worker to wake up. */
+  long long       sleep_until_ns_;          /**< Monotonic time of the next wake up [ns]. */
+  pthread_mutex_t wake_mutex_;              /**< Protects wake_pending_ and sleep_until_ns_. */
+  pthread_cond_t  wake_cond_;               /**< Signaled on new events or commands. */
+
+  /** Instrumentation. */
+  WorkerStats     stats_;                   /**< Loop timing, lateness and time per node. */
+  Profiler        profiler_;                /**< Inclusive/exclusive time by call path. */
+
+  /** Realtime settings (written with the worker lock, copied by apply_settings). */
+  volatile bool   settings_changed_;        /**< Settings must be applied on next loop. */
+  int             priority_;                /**< SCHED_FIFO priority (0 = default). */
+  int             cpu_;                     /**< Cpu to run on (-1 = any). */
+  size_t          prefault_stack_;          /**< Stack to touch on start [KB]. */
+
+  /** Settings in use (written by the worker thread in apply_settings). */
+  volatile int    applied_priority_;        /**< SCHED_FIFO priority in use (0 = default). */
+  volatile int    applied_cpu_;             /**< Cpu in use (-1 = any). */
+  volatile size_t applied_prefault_;        /**< Stack touched [KB]. */
+  bool            default_saved_;           /**< Scheduling before the first SCHED_FIFO was saved. */
+  int             default_policy_;          /**< Policy restored with priority 0. */
+  int             default_sched_priority_;  /**< Priority restored with priority 0. */
 };
 
 #endif // _WORKER_H_
\ No newline at end of file
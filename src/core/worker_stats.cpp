@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "worker_stats.h"
+#include "node.h"
+#include "profiler.h"
+
+void WorkerStats::reset() {
+  loop_count_    = 0;
+  loop_total_us_ = 0;
+  loop_last_us_  = 0;
+  loop_max_us_   = 0;
+  deferred_loops_ = 0;
+  deferred_nodes_ = 0;
+  events_total_  = 0;
+  events_last_   = 0;
+  events_max_    = 0;
+  missed_        = 0;
+  for (size_t i = 0; i < WORKER_STATS_LATENESS_BUCKETS; ++i) lateness_[i] = 0;
+  // keep the slots (nodes are still in the worker)
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    nodes_[i].total_us_ = 0;
+    nodes_[i].count_    = 0;
+  }
+}
+
+long long WorkerStats::now_us() {
+  // monotonic: wall clock steps would corrupt durations
+  return Profiler::now_ns() / 1000;
+}
+
+void WorkerStats::loop_done(long long duration_us, size_t events) {
+  ++loop_count_;
+  loop_total_us_ += duration_us;
+  loop_last_us_   = duration_us;
+  if (duration_us > loop_max_us_) loop_max_us_ = duration_us;
+
+  events_total_ += events;
+  events_last_   = events;
+  if (events > events_max_) events_max_ = events;
+}
+
+void WorkerStats::event_lateness(time_t lateness) {
+  // bucket 0 = [0,1[, bucket i = [2^(i-1), 2^i[
+  size_t bucket = 0;
+  while (lateness > 0 && bucket < WORKER_STATS_LATENESS_BUCKETS - 1) {
+    lateness >>= 1;
+    ++bucket;
+  }
+  ++lateness_[bucket];
+}
+
+void WorkerStats::node_time(Node *node, long long duration_us) {
+  size_t slot = node->stats_slot_;
+  if (slot >= nodes_.size() || nodes_[slot].node_ != node) return;
+  nodes_[slot].total_us_ += duration_us;
+  ++nodes_[slot].count_;
+}
+
+void WorkerStats::add(Node *node) {
+  if (node->stats_slot_ < nodes_.size() && nodes_[node->stats_slot_].node_ == node) return;
+  size_t slot;
+  if (free_slots_.empty()) {
+    slot = nodes_.size();
+    nodes_.push_back(NodeTime());
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  nodes_[slot] = NodeTime();
+  nodes_[slot].node_ = node;
+  node->stats_slot_ = slot;
+}
+
+void WorkerStats::forget(Node *node) {
+  size_t slot = node->stats_slot_;
+  if (slot >= nodes_.size() || nodes_[slot].node_ != node) return;
+  nodes_[slot].node_ = NULL;
+  free_slots_.push_back(slot);
+  node->stats_slot_ = WORKER_STATS_NO_SLOT;
+}
+
+size_t WorkerStats::calls(const Node *node) const {
+  size_t slot = node->stats_slot_;
+  if (slot >= nodes_.size() || nodes_[slot].node_ != node) return 0;
+  return nodes_[slot].count_;
+}
+
+void WorkerStats::merge(const WorkerStats &other) {
+  loop_count_    += other.loop_count_;
+  loop_total_us_ += other.loop_total_us_;
+  if (other.loop_last_us_ > loop_last_us_) loop_last_us_ = other.loop_last_us_;
+  if (other.loop_max_us_ > loop_max_us_) loop_max_us_ = other.loop_max_us_;
+  deferred_loops_ += other.deferred_loops_;
+  deferred_nodes_ += other.deferred_nodes_;
+
+  events_total_ += other.events_total_;
+  if (other.events_last_ > events_last_) events_last_ = other.events_last_;
+  if (other.events_max_ > events_max_) events_max_ = other.events_max_;
+  missed_ += other.missed_;
+
+  for (size_t i = 0; i < WORKER_STATS_LATENESS_BUCKETS; ++i) lateness_[i] += other.lateness_[i];
+
+  // a node lives in a single worker: merged slots are only used for reports
+  for (size_t i = 0; i < other.nodes_.size(); ++i) {
+    if (other.nodes_[i].node_) nodes_.push_back(other.nodes_[i]);
+  }
+}
+
+const Value WorkerStats::loops() const {
+  HashValue res;
+  res.set("count",   Value((Real)loop_count_));
+  res.set("last",    Value((Real)loop_last_us_));
+  res.set("average", Value(loop_count_ ? (Real)loop_total_us_ / loop_count_ : 0.0));
+  res.set("max",     Value((Real)loop_max_us_));
+  res.set("deferred", Value((Real)deferred_loops_));
+  res.set("deferred_nodes", Value((Real)deferred_nodes_));
+  return res;
+}
+
+const Value WorkerStats::lateness() const {
+  Value res;
+  for (size_t i = 0; i < WORKER_STATS_LATENESS_BUCKETS; ++i) {
+    res.push_back(Value((Real)lateness_[i]));
+  }
+  return res;
+}
+
+const Value WorkerStats::events() const {
+  HashValue res;
+  res.set("total",  Value((Real)events_total_));
+  res.set("last",   Value((Real)events_last_));
+  res.set("max",    Value((Real)events_max_));
+  res.set("missed", Value((Real)missed_));
+  return res;
+}
+
+const Value WorkerStats::nodes() const {
+  HashValue res;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const NodeTime &node_time = nodes_[i];
+    if (!node_time.node_ || !node_time.count_) continue;
+    Value time;
+    time.push_back(Value((Real)node_time.total_us_));
+    time.push_back(Value((Real)node_time.count_));
+    res.set(node_time.node_->url(), time);
+  }
+  return res;
+}
+
+const Value WorkerStats::report() const {
+  HashValue res;
+  res.set("loops",    loops());
+  res.set("lateness", lateness());
+  res.set("events",   events());
+  res.set("nodes",    nodes());
+  return res;
+}
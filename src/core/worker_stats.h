@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#ifndef RUBYK_SRC_CORE_WORKER_STATS_H_
+#define RUBYK_SRC_CORE_WORKER_STATS_H_
+#include "oscit.h"
+
+#include <vector>
+
+class Node;
+
+/** Value of Node::stats_slot_ when the node has no slot in the statistics. */
+#define WORKER_STATS_NO_SLOT ((size_t)-1)
+
+/** Number of buckets in the lateness histogram: [0,1[ [1,2[ [2,4[ ... [512,inf[ ms. */
+#define WORKER_STATS_LATENESS_BUCKETS 11
+
+/** Timing statistics of a Worker (loop duration, event lateness, events per tick and
+ *  time spent in each node).
+ *
+ *  When disabled, the worker only checks 'enabled()' once per loop and once per event.
+ *  Statistics are written by the worker thread: read them with the worker lock.
+ */
+class WorkerStats
+{
+ public:
+  WorkerStats() : enabled_(false) {
+    reset();
+  }
+
+  bool enabled() const { return enabled_; }
+
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+
+  /** Clear all counters. */
+  void reset();
+
+  /** Current monotonic time in [us] (only differences matter). */
+  static long long now_us();
+
+  /** Record a loop: time spent with the worker lock and number of events triggered. */
+  void loop_done(long long duration_us, size_t events);
+
+  /** Record how late an event was triggered [ms]. */
+  void event_lateness(time_t lateness);
+
+  /** Record an event that was registered too late to be triggered. */
+  void event_missed() { ++missed_; }
+
+  /** Record looped nodes deferred to the next loop because the loop budget was consumed
+   *  (always counted, even when the statistics are disabled).
+   */
+  void loop_deferred(size_t nodes) {
+    ++deferred_loops_;
+    deferred_nodes_ += nodes;
+  }
+
+  /** Number of loops that deferred looped nodes. */
+  size_t deferred_loops() const { return deferred_loops_; }
+
+  /** Total number of deferred looped node bangs. */
+  size_t deferred_nodes() const { return deferred_nodes_; }
+
+  /** Record time spent in a node (event or loop bang). Nodes without a slot are ignored:
+   *  this never allocates in the worker thread.
+   */
+  void node_time(Node *node, long long duration_us);
+
+  /** Reserve a slot for a node joining the worker (called with the worker lock). */
+  void add(Node *node);
+
+  /** Free the slot of a node leaving the worker or dying. */
+  void forget(Node *node);
+
+  /** Number of timed calls recorded for a node. */
+  size_t calls(const Node *node) const;
+
+  /** Add counters from another worker. */
+  void merge(const WorkerStats &other);
+
+  /** Loop timing {count, last, average, max} in [us] and deferred counters {deferred, deferred_nodes}. */
+  const Value loops() const;
+
+  /** Lateness histogram (list of counts, see WORKER_STATS_LATENESS_BUCKETS). */
+  const Value lateness() const;
+
+  /** Events per tick {total, last, max, missed}. */
+  const Value events() const;
+
+  /** Time spent in each node {url: [total us, calls]}. */
+  const Value nodes() const;
+
+  /** All statistics in a single hash. */
+  const Value report() const;
+
+ private:
+  struct NodeTime {
+    NodeTime() : node_(NULL), total_us_(0), count_(0) {}
+    Node     *node_;      /**< NULL for a free slot. */
+    long long total_us_;
+    size_t    count_;
+  };
+
+  bool enabled_;
+
+  size_t    loop_count_;
+  long long loop_total_us_;
+  long long loop_last_us_;
+  long long loop_max_us_;
+
+  size_t deferred_loops_;
+  size_t deferred_nodes_;
+
+  size_t events_total_;
+  size_t events_last_;
+  size_t events_max_;
+  size_t missed_;
+
+  size_t lateness_[WORKER_STATS_LATENESS_BUCKETS];
+
+  std::vector<NodeTime> nodes_;  /**< Slots indexed by Node::stats_slot_. */
+  std::vector<size_t> free_slots_;
+};
+
+#endif // RUBYK_SRC_CORE_WORKER_STATS_H_
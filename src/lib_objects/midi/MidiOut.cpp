@@ -3,7 +3,7 @@
 
 class MidiOut : public Node {
  public:
-  MidiOut() : port_id_(-1), midi_out_(NULL) {
+  MidiOut() : port_id_(-1), midi_out_(NULL), off_data_(3) {
     set_is_ok(false);  // port not opened
     try {
       midi_out_ = new RtMidiOut;
@@ -14,6 +14,8 @@ class MidiOut : public Node {
   }
   
   virtual ~MidiOut() {
+    // send pending note off while the port is still open
+    remove_my_events();
     if (midi_out_) {
       delete midi_out_;
     }
@@ -76,12 +78,25 @@ class MidiOut : public Node {
     const MidiMessage *msg = val.midi_message_;
     midi_out_->sendMessage( &(msg->data()) );
     if (msg->type() == NoteOn && msg->length() > 0) {
-      Value out(msg); // copy
-      out.midi_message_->note_on_to_off();
-      bang_me_in(msg->length(), out, true);
+      // keep channel and note in a Real: senders like NoteOut reuse their message,
+      // so the note on cannot be shared and a deep copy would allocate.
+      const std::vector<unsigned char> &data = msg->data();
+      Real key = (Real)(((data[0] & 0x0F) << 8) | data[1]);
+      worker_->register_event<MidiOut, &MidiOut::note_off>(worker_->now() + msg->length(), this, Value(key), true);
     }
   }
   
+  /** Send the note off matching a note on (forced event: also sent when quitting).
+   */
+  void note_off(const Value &val) {
+    if (!is_ok()) return;
+    int key = (int)val.r;                     // (channel << 8) | note
+    off_data_[0] = 0x80 | ((key >> 8) & 0x0F); // note off, same channel
+    off_data_[1] = key & 0xFF;                 // note
+    off_data_[2] = 0;                          // velocity
+    midi_out_->sendMessage( &off_data_ );
+  }
+  
   // void clear() {
   //   remove_my_events();
   // }
@@ -185,9 +200,13 @@ private:
    *  object construction.
    */
   Value error_;
+  
+  /** Scratch buffer for note off messages (avoids copying the note on).
+   */
+  std::vector<unsigned char> off_data_;
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(MidiOut) {
   CLASS (MidiOut, "Port to send midi values out. If no port is provided, tries to open a virtual port.", 
                   "port: [port number/name]");
   // using ADD_METHOD so that only the method is added without inlet (first method = port, first inlet = midi)
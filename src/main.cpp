@@ -34,7 +34,9 @@
 int main(int argc, char * argv[])
 {
   Planet venus(argc, argv);
-  venus.adopt_command(new CommandLine(std::cin, std::cout));
+  CommandLine *command_line = new CommandLine(std::cin, std::cout);
+  command_line->set_async(venus.async_commands());
+  venus.adopt_command(command_line);
   venus.adopt_command(new OscCommand("oscit", "_oscit._udp", 7000));
   venus.start();
   venus.join(); // wait for venus to finish
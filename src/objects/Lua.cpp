@@ -32,7 +32,7 @@
 class Lua : public LuaScript {
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(Lua) {
   CLASS(Lua, "Lua script.", "script: [script content] or file: [path to file]")
   // {1}
   ADD_SUPER_METHOD(Lua, Script, file, StringIO("path", "Set path to script content."))
@@ -72,7 +72,7 @@ public:
   // internal use only (looped call)
   void bang(const Value &val) {
     if (run_) {
-      // TODO: optimize: reuse previous event (send it in Value& val as EventValue ?)
+      // events come from the worker's EventPool: no allocation here
       bang_me_in(ONE_MINUTE / tempo_);
       send(gNilValue);
     }
@@ -97,7 +97,7 @@ private:
   bool run_;
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(Metro) {
   std::cout << "Metro::init\n";
   CLASS( Metro, "Metronome that sends bangs at regular intervals.", "tempo: [initial tempo]")
   METHOD(Metro, tempo,RealIO("bpm", "Restart metronome | set tempo value."))
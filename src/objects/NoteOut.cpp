@@ -87,7 +87,7 @@ private:
   Value  note_;
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(NoteOut) {
   CLASS (NoteOut, "Helper to create a note.", "note, velocity, length, channel");
   METHOD(NoteOut, note, RangeIO(0, 127, "midi note", "Set value / send note out."));
   OUTLET(NoteOut, note, MidiIO("Midi note."));
@@ -50,7 +50,7 @@ public:
   }
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(OscMap) {
   CLASS (OscMap, "Open udp ports and map calls from these ports.", "script: [mapping definitions] or file: [path to mapping file]")
   // {1}
   c->add_method<Script, &Script::file>("file", StringIO("path", "Set path to mappings definitions."));
@@ -30,7 +30,7 @@
 #include "rubyk.h"
 #include "print.h"
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(Print) {
   CLASS(Print, "Print any value received in bang inlet.", "no options")
   // [1] print
   INLET(Print, print, AnyIO("Received values are printed out."))
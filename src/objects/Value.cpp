@@ -50,7 +50,7 @@ private:
   Value value_;
 };
 
-extern "C" void init(Planet &planet) {
+RUBYK_INIT(Value) {
   Class * c = planet.classes()->declare<ValueNode>("Value", "Stores a number which can be sent again through Bang!.", "value: [initial value]");
   METHOD(ValueNode, value, AnyIO("Set/get current value."))
   OUTLET(ValueNode, value, AnyIO("Send the current value out."))
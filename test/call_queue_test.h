@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "test_helper.h"
+#include "call_queue.h"
+
+#define CALL_QUEUE_TEST_THREADS 4
+#define CALL_QUEUE_TEST_COUNT   1000
+
+static void *call_queue_test_producer(void *data) {
+  CallQueue *queue = (CallQueue*)data;
+  for (int i = 0; i < CALL_QUEUE_TEST_COUNT; ++i) {
+    queue->push(new QueuedCall("/foo", Value((Real)i)));
+  }
+  return NULL;
+}
+
+class CallQueueTest : public TestHelper
+{
+public:
+  void test_push_pop( void ) {
+    CallQueue queue;
+    QueuedCall *call;
+    assert_equal((QueuedCall*)NULL, queue.pop());
+    
+    queue.push(new QueuedCall("/a", Value(1.0)));
+    queue.push(new QueuedCall("/b", Value(2.0)));
+    
+    call = queue.pop();
+    assert_equal("/a", call->url_);
+    assert_equal(1.0, call->param_.r);
+    delete call;
+    
+    queue.push(new QueuedCall("/c", Value(3.0)));
+    
+    call = queue.pop();
+    assert_equal("/b", call->url_);
+    delete call;
+    call = queue.pop();
+    assert_equal("/c", call->url_);
+    delete call;
+    assert_equal((QueuedCall*)NULL, queue.pop());
+  }
+  
+  void test_pool_recycles_calls( void ) {
+    CallPool pool;
+    CallQueue queue;
+    Value param(1.0);
+    QueuedCall *call = pool.get("/a", param);
+    queue.push(call);
+    
+    QueuedCall *popped = queue.pop();
+    assert_equal(call, popped);
+    assert_equal("/a", popped->url_);
+    assert_equal(1.0, popped->param_.r);
+    pool.recycle(popped);
+    assert_true(popped->param_.is_nil());
+    
+    // recycled calls are reused: no allocation once the pool is warm
+    call = pool.get("/b", Value(2.0));
+    assert_equal(popped, call);
+    assert_equal("/b", call->url_);
+    assert_equal(2.0, call->param_.r);
+    delete call;
+  }
+  
+  void test_many_producers( void ) {
+    CallQueue queue;
+    pthread_t threads[CALL_QUEUE_TEST_THREADS];
+    QueuedCall *call;
+    int count = 0;
+    
+    for (int i = 0; i < CALL_QUEUE_TEST_THREADS; ++i) {
+      pthread_create(&threads[i], NULL, call_queue_test_producer, &queue);
+    }
+    
+    for (int i = 0; i < CALL_QUEUE_TEST_THREADS; ++i) {
+      pthread_join(threads[i], NULL);
+    }
+    
+    while ( (call = queue.pop()) ) {
+      ++count;
+      delete call;
+    }
+    assert_equal(CALL_QUEUE_TEST_THREADS * CALL_QUEUE_TEST_COUNT, count);
+  }
+};
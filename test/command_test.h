@@ -29,6 +29,22 @@
 
 #include "test_helper.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Object compiled in the executable (see RUBYK_STATIC_OBJECTS). */
+class StaticDummy : public Node
+{
+public:
+  TYPED("Object.Node.StaticDummy")
+};
+
+static void CommandTest_static_init(Planet &planet) {
+  planet.classes()->declare<StaticDummy>("StaticDummy", "Compiled in object.", "no options");
+}
+
+static StaticObject sCommandTestStaticDummy("StaticDummy", CommandTest_static_init);
+
 class CreateCommandTest : public TestHelper
 {
 public:
@@ -67,6 +83,159 @@ public:
     assert_print("p: 34\n", "n/value\n");
   }
   
+  void test_async_call( void ) {
+    setup_with_print("n = Value(34)\n");
+    cmd_->set_async(true);
+    assert_print("", "n/value\n"); // posted to worker
+    planet_->loop();
+    assert_equal("p: 34\n", print_.str());
+  }
+  
+  void test_async_create( void ) {
+    cmd_->set_async(true);
+    assert_result("# <Value:/v1 value:2.52>\n", "v1=Value(2.52)\n"); // not posted
+  }
+  
+  void test_async_calls_keep_order( void ) {
+    setup_with_print("n = Value(34)\n");
+    cmd_->set_async(true);
+    assert_print("", "n/value(5)\n"); // posted to worker
+    // the link is removed after the posted call
+    assert_print("p: 5\n", "n || p\n");
+    planet_->loop();
+    assert_equal("p: 5\n", print_.str());
+  }
+  
+  void test_worker_affinity( void ) {
+    setup_with_print("n = Value(34)\n");
+    assert_result("# 2\n", "/rubyk/workers(2)\n");
+    assert_result("# 1\n", "/n/affinity(1)\n");
+    assert_print("", "n/value\n"); // p lives in the main worker
+    planet_->loop();
+    assert_equal("p: 34\n", print_.str());
+  }
+  
+  void test_preload_classes( void ) {
+    Value manifest;
+    manifest.push_back(Value("Value"));
+    manifest.push_back(Value("NotAClass"));
+    Value loaded = planet_->classes()->preload(manifest);
+    assert_equal(1, (int)loaded.size());
+    assert_equal("Value", loaded[0].str());
+    assert_true(planet_->classes()->find_class("Value") != NULL);
+    assert_true(planet_->classes()->is_missing("NotAClass"));
+  }
+  
+  void test_static_object( void ) {
+    assert_true(StaticObject::find("StaticDummy") != NULL);
+    setup("s = StaticDummy()\n");
+    assert_true(planet_->classes()->find_class("StaticDummy") != NULL);
+    assert_true(planet_->object_at("/s") != NULL);
+  }
+  
+  void test_missing_class_is_cached( void ) {
+    setup("x = Foobar()\n");
+    assert_true(planet_->classes()->is_missing("Foobar"));
+    // changing the lib path clears the cache
+    planet_->call(LIB_URL, Value(TEST_LIB_PATH));
+    assert_false(planet_->classes()->is_missing("Foobar"));
+  }
+  
+  void test_missing_class_same_error( void ) {
+    cmd_->parse("x = Foobar()\n");
+    std::string first = output_.str();
+    output_.str(std::string(""));
+    cmd_->parse("x = Foobar()\n"); // cached
+    assert_true(first.find("# 404 ") != std::string::npos);
+    assert_equal(first, output_.str());
+  }
+  
+  void test_bulk_load( void ) {
+    planet_->begin_bulk_load();
+    cmd_->parse("n = Value(34)\nn => p\np = Print()\nn => x\n");
+    assert_true(planet_->bulk_loading());
+    Value report = planet_->end_bulk_load();
+    assert_false(planet_->bulk_loading());
+    assert_true(report.is_hash());
+    
+    Print *print = TYPE_CAST(Print, planet_->object_at("/p"));
+    assert_true(print != NULL);
+    print->set_output(&print_);
+    assert_print("p: 34\n", "n/value\n");
+    // link to 'x' is still pending
+    assert_result("# /n || /x\n", "n || x\n");
+  }
+  
+  void test_parse_chunks( void ) {
+    const char *script = "n = Value(34)\nn => p\np = Print()\n";
+    // tokens split across chunks
+    for (const char *p = script; *p; p += 2) {
+      cmd_->parse(p, p[1] ? 2 : 1);
+    }
+    Print *print = TYPE_CAST(Print, planet_->object_at("/p"));
+    assert_true(print != NULL);
+    print->set_output(&print_);
+    assert_print("p: 34\n", "n/value\n");
+  }
+  
+  void test_syntax_error_on_first_byte_of_chunk( void ) {
+    cmd_->parse("!", 1); // the error action steps back before the chunk
+    cmd_->parse("\n");
+    assert_equal("# Syntax error near '!'.\n", output_.str());
+  }
+  
+  void test_listen_long_line( void ) {
+    std::string line("v1=Value(value:");
+    line.append(1500, '0').append("1)\n");
+    std::istringstream input(line);
+    std::ostringstream output(std::ostringstream::out);
+    planet_->adopt_command(new TextCommand(input, output));
+    microsleep(20);
+    assert_true(planet_->object_at("/v1") != NULL); // not cut at 1023 bytes
+  }
+  
+  void test_parse_missing_file( void ) {
+    assert_false(cmd_->parse_file("/no/such/patch.rk"));
+  }
+  
+  void test_worker_settings( void ) {
+    assert_result("# 64\n", "/rubyk/worker/prefault(64)\n");
+    assert_result("# 1\n", "/rubyk/worker/deadline(1)\n");
+    assert_true(planet_->worker()->deadline_mode());
+    assert_equal(64, (int)planet_->worker()->prefault_stack());
+    assert_result("# 500\n", "/rubyk/worker/budget(500)\n");
+    assert_equal(500, (int)planet_->worker()->loop_budget());
+  }
+  
+  void test_stats_dump( void ) {
+    const char *path = "/tmp/rubyk_stats_dump_test.txt";
+    struct stat info;
+    unlink(path);
+    planet_->call(std::string(STATS_URL).append("/dump"), Value(path).push_back(Value(0.1)));
+    for (size_t i = 0; i < 50; ++i) {
+      planet_->loop(); // runs the snapshots posted by the dump thread
+      microsleep(10);
+    }
+    planet_->worker()->lock();
+      // stopping with the worker locked does not wait on the dump thread
+      planet_->call(std::string(STATS_URL).append("/dump"), gNilValue);
+    planet_->worker()->unlock();
+    assert_equal(0, stat(path, &info));
+    assert_true(info.st_size > 0);
+    unlink(path);
+  }
+  
+  void test_worker_prefault_limit( void ) {
+    size_t max = Worker::max_prefault_stack();
+    assert_true(max > 0);
+    assert_false(planet_->worker()->set_prefault_stack(max + 1));
+    assert_equal(0, (int)planet_->worker()->prefault_stack());
+    assert_true(planet_->worker()->set_prefault_stack(16));
+    planet_->loop(); // applied by the thread running the loop
+    assert_equal(16, (int)planet_->worker()->applied_prefault());
+    assert_equal(-1, planet_->worker()->applied_cpu());
+  }
+  
   
 //  void test_parse_zero( void ) 
 //  { assert_result("v1=Number(0)\n","<Number:/v1 0.00>\n"); }
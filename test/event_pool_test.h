@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "test_helper.h"
+#include "event_pool.h"
+
+class EventPoolTest : public TestHelper
+{
+public:
+  void test_reuse_blocks( void ) {
+    EventPool pool;
+    DummyNode node(0.0);
+    Event *events[10];
+    
+    for (int i = 0; i < 10; ++i) {
+      events[i] = new(&pool) BangEvent(&node, 10);
+    }
+    assert_equal(10, pool.in_use());
+    assert_equal(10, pool.high_water_mark());
+    size_t capacity = pool.capacity();
+    
+    for (int i = 0; i < 10; ++i) {
+      delete events[i];
+    }
+    assert_equal(0, pool.in_use());
+    
+    for (int i = 0; i < 5; ++i) {
+      events[i] = new(&pool) BangEvent(&node, 10);
+    }
+    // no new memory
+    assert_equal(capacity, pool.capacity());
+    assert_equal(10, pool.high_water_mark());
+    
+    for (int i = 0; i < 5; ++i) {
+      delete events[i];
+    }
+  }
+  
+  void test_heap_event( void ) {
+    EventPool pool;
+    DummyNode node(0.0);
+    Event *event = new BangEvent(&node, 10);
+    assert_equal(0, pool.in_use());
+    delete event; // should not crash
+  }
+  
+  void test_reserve( void ) {
+    EventPool pool;
+    pool.reserve(1000);
+    assert_true(pool.capacity() >= 1000);
+    assert_equal(0, pool.in_use());
+  }
+};
@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "test_helper.h"
+#include "event_queue.h"
+
+class EventQueueTest : public TestHelper
+{
+public:
+  void test_push_pop( void ) {
+    EventQueue queue;
+    DummyNode node(0.0);
+    Event *a = new BangEvent(&node, 30);
+    Event *b = new BangEvent(&node, 10);
+    Event *c = new BangEvent(&node, 20);
+    Event *e;
+    
+    assert_true(queue.empty());
+    assert_false(queue.get(&e));
+    
+    queue.push(a);
+    queue.push(b);
+    queue.push(c);
+    queue.push(c); // only stored once
+    assert_equal(3, queue.size());
+    
+    assert_equal(b, queue.front());
+    queue.pop();
+    assert_equal(c, queue.front());
+    queue.pop();
+    assert_true(queue.get(&e));
+    assert_equal(a, e);
+    queue.pop();
+    assert_true(queue.empty());
+    delete a;
+    delete b;
+    delete c;
+  }
+  
+  void test_same_time_keeps_insertion_order( void ) {
+    EventQueue queue;
+    DummyNode node(0.0);
+    Event *events[10];
+    for (int i = 0; i < 10; ++i) {
+      events[i] = new BangEvent(&node, 50);
+      queue.push(events[i]);
+    }
+    
+    for (int i = 0; i < 10; ++i) {
+      assert_equal(events[i], queue.front());
+      queue.pop();
+      delete events[i];
+    }
+  }
+  
+  void test_remove( void ) {
+    EventQueue queue;
+    DummyNode node(0.0);
+    Event *a = new BangEvent(&node, 10);
+    Event *b = new BangEvent(&node, 20);
+    Event *c = new BangEvent(&node, 30);
+    queue.push(a);
+    queue.push(b);
+    queue.push(c);
+    
+    assert_true(queue.remove(b));
+    assert_false(queue.remove(b));
+    assert_equal(2, queue.size());
+    assert_equal(a, queue.front());
+    queue.pop();
+    assert_equal(c, queue.front());
+    delete a;
+    delete b;
+    delete c;
+  }
+  
+  void test_first_event_for( void ) {
+    EventQueue queue;
+    DummyNode node(0.0), other(0.0);
+    Event *a = new BangEvent(&node,  10);
+    Event *b = new BangEvent(&other, 20);
+    Event *c = new BangEvent(&node,  30);
+    Event *e;
+    queue.push(a);
+    queue.push(b);
+    queue.push(c);
+    
+    int count = 0;
+    while ( (e = queue.first_event_for(&node)) ) {
+      assert_true(e == a || e == c);
+      queue.remove(e);
+      ++count;
+    }
+    assert_equal(2, count);
+    assert_equal(1, queue.size());
+    assert_equal(b, queue.front());
+    assert_equal(b, queue.first_event_for(&other));
+    queue.pop();
+    assert_equal((Event*)NULL, queue.first_event_for(&other));
+    delete a;
+    delete b;
+    delete c;
+  }
+};
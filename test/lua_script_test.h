@@ -28,14 +28,23 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include "test_helper.h"
 #include "lua_script.h"
+#include "lua_inlet.h"
+#include "lua_vm.h"
 
 class LuaScriptTest : public TestHelper {
 public:
   virtual void setUp() {
+    // process-wide settings changed by some tests
+    LuaVM::set_shared(false);
+    LuaVM::set_cache_path("");
     planet_ = new Planet();
     planet_->call(LIB_URL, Value(TEST_LIB_PATH));
     script_ = planet_->adopt(new LuaScript);
@@ -52,6 +61,8 @@ public:
   void tearDown() {
     if (planet_) delete planet_;
     planet_ = NULL;
+    LuaVM::set_shared(false);
+    LuaVM::set_cache_path("");
   }
   
   void test_compile( void ) {
@@ -123,9 +134,144 @@ public:
     assert_equal("Sends note values.", outlet->type()[2].str()); // info
   }
   
+  void test_inlet_function_resolved( void ) {
+    Value res = parse("inlet('tempo', RealIO('bpm', 'Main beat machine tempo.'))\nfunction tempo(r)\nend");
+    assert_true(res.is_string());
+    LuaInlet *inlet = TYPE_CAST(LuaInlet, planet_->object_at("/lua/in/tempo"));
+    assert_true(inlet != NULL);
+    assert_false(script_->call_inlet(inlet, Value(1.0)).is_error());
+    
+    res = parse("inlet('beat', RealIO('bpm', 'No function for this one.'))");
+    inlet = TYPE_CAST(LuaInlet, planet_->object_at("/lua/in/beat"));
+    assert_true(inlet != NULL);
+    assert_true(script_->call_inlet(inlet, Value(1.0)).is_error()); // no function
+  }
+  
+  void test_inlet_function_reassigned( void ) {
+    Value res = parse("inlet('tempo', RealIO('bpm', 'Tempo.'))\nx = 0\nfunction tempo(r)\n  x = 1\n  tempo = function(r) x = 2 end\nend\nfunction get_x()\n  return x\nend");
+    assert_true(res.is_string());
+    LuaInlet *inlet = TYPE_CAST(LuaInlet, planet_->object_at("/lua/in/tempo"));
+    assert_true(inlet != NULL);
+    
+    script_->call_inlet(inlet, Value(1.0));
+    assert_equal(1.0, script_->call_lua("get_x", gNilValue).r);
+    // handler replaced by the script at runtime
+    script_->call_inlet(inlet, Value(1.0));
+    assert_equal(2.0, script_->call_lua("get_x", gNilValue).r);
+  }
+  
+  void test_shared_vm( void ) {
+    LuaVM::set_shared(true);
+    LuaScript *a = make_script("a");
+    LuaScript *b = make_script("b");
+    LuaVM::set_shared(false);
+    assert_equal(1, (int)LuaVM::count());
+    
+    assert_true(a->script(Value("inlet('tempo', RealIO('bpm', 'Tempo.'))\nfunction tempo(r)\nend")).is_string());
+    assert_true(b->script(Value("inlet('tempo', RealIO('bpm', 'Tempo.'))")).is_string());
+    LuaInlet *inlet_a = TYPE_CAST(LuaInlet, planet_->object_at("/a/in/tempo"));
+    LuaInlet *inlet_b = TYPE_CAST(LuaInlet, planet_->object_at("/b/in/tempo"));
+    assert_true(inlet_a && !a->call_inlet(inlet_a, Value(1.0)).is_error());
+    // 'tempo' defined by 'a' is not visible in 'b'
+    assert_true(inlet_b && b->call_inlet(inlet_b, Value(1.0)).is_error());
+    
+    delete a;
+    assert_equal(1, (int)LuaVM::count());
+    delete b;
+    assert_equal(0, (int)LuaVM::count());
+  }
+  
+  void test_bytecode_cache( void ) {
+    char dir[] = "/tmp/rubyk_lua_cacheXXXXXX";
+    assert_true(mkdtemp(dir) != NULL);
+    LuaVM::set_cache_path(dir);
+    const char *code = "inlet('tempo', RealIO('bpm', 'Tempo.'))\nfunction tempo(r)\nend";
+    size_t hits = LuaVM::cache_hits();
+    assert_true(parse(code).is_string());
+    assert_equal(hits, LuaVM::cache_hits()); // compiled
+    // second evaluation reuses the bytecode (memory)
+    assert_true(parse(code).is_string());
+    assert_equal(hits + 1, LuaVM::cache_hits());
+    // the cache thread writes the file before it stops
+    LuaVM::set_cache_path("");
+    assert_equal(1, count_files(dir));
+
+    // new process (no scripts in memory): loaded from the directory
+    LuaVM::set_cache_path(dir);
+    assert_true(parse(code).is_string());
+    assert_equal(hits + 2, LuaVM::cache_hits());
+    LuaInlet *inlet = TYPE_CAST(LuaInlet, planet_->object_at("/lua/in/tempo"));
+    assert_true(inlet && !script_->call_inlet(inlet, Value(1.0)).is_error());
+    
+    LuaVM::set_cache_path("");
+    assert_equal(1, count_files(dir));
+    remove_files(dir);
+  }
+  
+  void test_bytecode_cache_pruned( void ) {
+    char dir[] = "/tmp/rubyk_lua_cacheXXXXXX";
+    assert_true(mkdtemp(dir) != NULL);
+    // old files from previous edits
+    struct utimbuf old_time;
+    old_time.actime  = 1000;
+    old_time.modtime = 1000;
+    char name[64];
+    for (int i = 0; i < LUA_CACHE_MAX_FILES + 10; ++i) {
+      snprintf(name, sizeof(name), "%s/old%i.luac", dir, i);
+      FILE *file = fopen(name, "wb");
+      assert_true(file != NULL);
+      fclose(file);
+      utime(name, &old_time);
+    }
+    // pruned once by the cache thread
+    LuaVM::set_cache_path(dir);
+    LuaVM::set_cache_path("");
+    assert_equal(LUA_CACHE_MAX_FILES, count_files(dir));
+
+    // new files are not pruned before the next start
+    LuaVM::set_cache_path(dir);
+    assert_true(parse("function tempo(r)\nend").is_string());
+    LuaVM::set_cache_path("");
+    assert_equal(LUA_CACHE_MAX_FILES + 1, count_files(dir));
+    
+    remove_files(dir);
+  }
+  
   // sending tested in LuaTest
   
 private:
+  static int count_files(const char *path) {
+    int count = 0;
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) ) {
+      if (entry->d_name[0] != '.') ++count;
+    }
+    closedir(dir);
+    return count;
+  }
+  
+  static void remove_files(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) ) {
+      if (entry->d_name[0] != '.') unlink(std::string(path).append("/").append(entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path);
+  }
+  
+  LuaScript *make_script(const char *name) {
+    LuaScript *script = planet_->adopt(new LuaScript);
+    script->set_name(name);
+    script->adopt(new Object("in"));
+    script->adopt(new Object("out"));
+    script->init();
+    return script;
+  }
+  
   const Value parse(const char *string) {
     return script_->script(Value(string));
   }
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "test_helper.h"
+#include "profiler.h"
+
+#include <sstream>
+
+class ProfilerTest : public TestHelper
+{
+public:
+  void test_inclusive_exclusive( void ) {
+    Root root;
+    Profiler profiler;
+    DummyNode *a = root.adopt(new DummyNode(0.0));
+    DummyNode *b = root.adopt(new DummyNode(0.0));
+    std::map<std::string, ProfileTotals> totals;
+    
+    profiler.set_enabled(true);
+    profiler.enter(a);
+      profiler.enter(b);
+        millisleep(2);
+      profiler.leave();
+      profiler.enter(b);
+      profiler.leave();
+    profiler.leave();
+    
+    profiler.collect(&totals);
+    assert_equal(2, (int)totals.size());
+    assert_equal(1, (int)totals[a->url()].calls_);
+    assert_equal(2, (int)totals[b->url()].calls_);
+    assert_true(totals[a->url()].inclusive_ns_ >= totals[b->url()].inclusive_ns_);
+    assert_true(totals[a->url()].exclusive_ns_ < totals[b->url()].exclusive_ns_);
+  }
+  
+  void test_folded_stacks( void ) {
+    Root root;
+    Profiler profiler;
+    DummyNode *a = root.adopt(new DummyNode(0.0));
+    DummyNode *b = root.adopt(new DummyNode(0.0));
+    std::ostringstream out;
+    
+    profiler.enter(a);
+      profiler.enter(b);
+        millisleep(2);
+      profiler.leave();
+    profiler.leave();
+    
+    profiler.write_folded(out, "worker0");
+    std::string prefix = std::string("worker0;").append(a->url()).append(";").append(b->url()).append(" ");
+    assert_true(out.str().find(prefix) != std::string::npos);
+  }
+  
+  void test_reset_while_running( void ) {
+    Root root;
+    Profiler profiler;
+    DummyNode *a = root.adopt(new DummyNode(0.0));
+    std::map<std::string, ProfileTotals> totals;
+    
+    profiler.enter(a);
+      profiler.reset(); // delayed
+    profiler.leave();
+    
+    profiler.collect(&totals);
+    assert_equal(0, (int)totals.size());
+  }
+};
@@ -48,6 +48,25 @@ static void SlotTest_receive_value4(Inlet *inlet, const Value &val) {
   *(((DummyNode*)receiver)->SlotTest_value_) = (2*(*((DummyNode*)receiver)->SlotTest_value_)) + val.r + 4;
 }
 
+// x = x + sum(block) * 10
+static void SlotTest_receive_block(Inlet *inlet, const SignalBlock &block) {
+  Node *receiver = inlet->node();
+  for (size_t i = 0; i < block.size(); ++i) *(((DummyNode*)receiver)->SlotTest_value_) += block.data_[i] * 10;
+}
+
+// change links while the outlet is sending (x = 2*x + y + 1)
+static Outlet *SlotTest_outlet   = NULL;
+static Inlet  *SlotTest_unlinked = NULL;
+static Inlet  *SlotTest_linked   = NULL;
+static void SlotTest_receive_and_relink(Inlet *inlet, const Value &val) {
+  SlotTest_receive_value1(inlet, val);
+  if (SlotTest_unlinked) {
+    SlotTest_outlet->disconnect(SlotTest_unlinked);
+    SlotTest_outlet->connect(SlotTest_linked);
+    SlotTest_unlinked = NULL;
+  }
+}
+
 class SlotTest : public TestHelper
 {
 public:
@@ -541,6 +560,162 @@ public:
     assert_equal(19.0, value); // order is now inlet1, inlet2, inlet3
   }
   
+  void test_disconnect( void ) {
+    Real value = 0;
+    DummyNode sender(&value);
+    DummyNode receiver1(&value);
+    DummyNode receiver2(&value);
+    Outlet outlet(&sender, RealIO("any", "Receive real values."));
+    Inlet  inlet1(&receiver1, SlotTest_receive_value1, RealIO("any", "Receive real values."));
+    Inlet  inlet2(&receiver2, SlotTest_receive_value2, RealIO("any", "Receive real values."));
+    
+    assert_true(outlet.connect(&inlet1));
+    assert_true(outlet.connect(&inlet2));
+    outlet.disconnect(&inlet1);
+    
+    outlet.send(Value(1.0));
+    assert_equal(3.0, value); // only inlet2: 2 * 0 + x + 2
+    
+    {
+      Inlet inlet3(&receiver1, SlotTest_receive_value4, RealIO("any", "Receive real values."));
+      assert_true(outlet.connect(&inlet3));
+    } // inlet3 dies and removes its connection
+    
+    value = 0.0;
+    outlet.send(Value(1.0));
+    assert_equal(3.0, value);
+  }
+  
+  void test_relink_while_sending( void ) {
+    Real value = 0;
+    DummyNode sender(&value);
+    DummyNode receiver1(&value);
+    DummyNode receiver2(&value);
+    DummyNode receiver3(&value);
+    Outlet outlet(&sender, RealIO("any", "Receive real values."));
+    Inlet  inlet1(&receiver1, SlotTest_receive_and_relink, RealIO("any", "Receive real values."));
+    Inlet  inlet2(&receiver2, SlotTest_receive_value2, RealIO("any", "Receive real values."));
+    Inlet  inlet3(&receiver3, SlotTest_receive_value4, RealIO("any", "Receive real values."));
+    receiver1.set_trigger_position(3.0); // triggers first
+    receiver2.set_trigger_position(2.0);
+    receiver3.set_trigger_position(1.0);
+    
+    assert_true(outlet.connect(&inlet1));
+    assert_true(outlet.connect(&inlet2));
+    SlotTest_outlet   = &outlet;
+    SlotTest_unlinked = &inlet2;
+    SlotTest_linked   = &inlet3;
+    
+    outlet.send(Value(1.0));
+    assert_equal(2.0, value); // inlet2 removed by inlet1, inlet3 linked for next send
+    
+    value = 0.0;
+    outlet.send(Value(1.0));
+    assert_equal(9.0, value); // 1: 0 + 1 + 1 = 2, 3: 4 + 1 + 4 = 9
+  }
+  
+  void test_sort_batch( void ) {
+    Planet planet; // owns the batch
+    Real value = 0;
+    DummyNode sender(&value);
+    DummyNode receiver1(&value);
+    DummyNode receiver2(&value);
+    sender.set_context(planet.worker());
+    receiver1.set_context(planet.worker());
+    receiver2.set_context(planet.worker());
+    Outlet outlet(&sender, RealIO("any", "Receive real values."));
+    Inlet  inlet1(&receiver1, SlotTest_receive_value1, RealIO("any", "Receive real values."));
+    Inlet  inlet2(&receiver2, SlotTest_receive_value4, RealIO("any", "Receive real values."));
+    receiver1.set_trigger_position(1.0);
+    receiver2.set_trigger_position(2.0); // should trigger first
+    
+    assert_true(outlet.connect(&inlet1));
+    assert_true(outlet.connect(&inlet2));
+    assert_true(outlet.connect(&inlet2)); // not added twice
+    assert_true(outlet.is_connected_to(&inlet2));
+    assert_true(inlet2.is_connected_to(&outlet));
+    
+    outlet.send(Value(1.0));
+    assert_equal(11.0, value); // 2: 0 + 1 + 4 = 5, 1: 10 + 1 + 1 = 11
+    
+    planet.sort_batch()->begin();
+      receiver1.set_trigger_position(3.0); // should trigger first
+      value = 0.0;
+      outlet.send(Value(1.0));
+      assert_equal(11.0, value); // not sorted yet
+    planet.sort_batch()->end();
+    
+    value = 0.0;
+    outlet.send(Value(1.0));
+    assert_equal(9.0, value); // 1: 0 + 1 + 1 = 2, 2: 4 + 1 + 4 = 9
+    
+    outlet.disconnect(&inlet2);
+    assert_false(outlet.is_connected_to(&inlet2));
+    assert_false(inlet2.is_connected_to(&outlet));
+  }
+  
+  void test_sort_batch_link( void ) {
+    Planet planet;
+    Real value = 0;
+    DummyNode sender(&value);
+    DummyNode receiver(&value);
+    sender.set_context(planet.worker());
+    receiver.set_context(planet.worker());
+    Outlet outlet(&sender, RealIO("any", "Receive real values."));
+    Inlet  inlet(&receiver, SlotTest_receive_value1, RealIO("any", "Receive real values."));
+    
+    planet.sort_batch()->begin();
+      assert_true(outlet.connect(&inlet));
+      outlet.send(Value(1.0));
+      assert_equal(0.0, value); // plan is rebuilt when the batch ends
+    planet.sort_batch()->end();
+    
+    outlet.send(Value(1.0));
+    assert_equal(2.0, value);
+  }
+  
+  void test_same_position_sorted_by_url( void ) {
+    Root base;
+    Real value = 0;
+    DummyNode *sender = base.adopt(new DummyNode(&value));
+    DummyNode *first  = base.adopt(new DummyNode(&value));
+    DummyNode *second = base.adopt(new DummyNode(&value));
+    // url order is the opposite of creation (and usually address) order
+    first->set_name("zz");
+    second->set_name("aa");
+    Outlet outlet(sender, RealIO("any", "Receive real values."));
+    Inlet  inlet1(first,  SlotTest_receive_value4, RealIO("any", "Receive real values."));
+    Inlet  inlet2(second, SlotTest_receive_value1, RealIO("any", "Receive real values."));
+    
+    assert_true(outlet.connect(&inlet1));
+    assert_true(outlet.connect(&inlet2));
+    outlet.send(Value(1.0));
+    assert_equal(9.0, value); // aa: 0 + 1 + 1 = 2, zz: 4 + 1 + 4 = 9
+  }
+  
+  void test_send_block( void ) {
+    Real value1 = 0, value2 = 0;
+    DummyNode sender(&value1);
+    DummyNode receiver1(&value1);
+    DummyNode receiver2(&value2);
+    Outlet outlet(&sender, RealIO("any", "Send blocks."));
+    Inlet  inlet1(&receiver1, SlotTest_receive_value1, RealIO("any", "Receive frame by frame."));
+    Inlet  inlet2(&receiver2, SlotTest_receive_value1, RealIO("any", "Receive blocks."));
+    inlet2.set_block_method(SlotTest_receive_block);
+    SignalBuffer block(3, 1);
+    block.data_[0] = 1.0;
+    block.data_[1] = 2.0;
+    block.data_[2] = 3.0;
+    
+    assert_true(outlet.connect(&inlet1));
+    assert_true(outlet.connect(&inlet2));
+    outlet.send_block(block);
+    // frame by frame (x = 2*x + y + 1): 2, 7, 18
+    assert_equal(18.0, value1);
+    // single call
+    assert_equal(60.0, value2);
+  }
+  
   void test_find_inlet( void ) {
     Root base;
     Real value = 0;
@@ -557,6 +732,24 @@ public:
     assert_equal("=>", res[1].str());
     assert_equal("/n-1/in/pong", res[2].str());
   }
+  
+  void test_slots_recycled_from_slab( void ) {
+    Root base;
+    Real value = 0;
+    DummyNode *node = base.adopt(new DummyNode(&value));
+    Object *in      = node->adopt(new Object("in"));
+    int used        = SlabAllocator<Inlet>::used();
+    
+    Inlet *inlet = in->adopt(new Inlet(node, "ping", SlotTest_receive_value1, RealIO("any", "Receive real values.")));
+    assert_equal(used + 1, (int)SlabAllocator<Inlet>::used());
+    void *address = inlet;
+    delete inlet;
+    assert_equal(used, (int)SlabAllocator<Inlet>::used());
+    // freed memory is reused first
+    inlet = in->adopt(new Inlet(node, "pong", SlotTest_receive_value1, RealIO("any", "Receive real values.")));
+    assert_true(address == (void*)inlet);
+    assert_true(SlabAllocator<Inlet>::capacity() >= SlabAllocator<Inlet>::used());
+  }
 };
 
 class SlotCommandTest : public ParseHelper
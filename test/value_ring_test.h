@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+   This file is part of the RUBYK project (http://rubyk.org)
+   Copyright (c) 2007-2009 by Gaspard Bucher - Buma (http://teti.ch).
+
+  ------------------------------------------------------------------------------
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+
+  ==============================================================================
+*/
+
+#include "test_helper.h"
+#include "value_ring.h"
+
+class ValueRingTest : public TestHelper
+{
+public:
+  void test_push_front_release( void ) {
+    ValueRing ring(4);
+    Inlet *inlet = (Inlet*)&ring; // only used as a tag
+    RingMessage *message;
+    assert_equal((void*)NULL, (void*)ring.front());
+    
+    assert_true(ring.push(inlet, Value(1.0)));
+    assert_true(ring.push(inlet, Value(2.0)));
+    
+    message = ring.front();
+    assert_equal((void*)inlet, (void*)message->inlet_);
+    assert_equal(1.0, message->value_.r);
+    ring.release();
+    
+    message = ring.front();
+    assert_equal(2.0, message->value_.r);
+    ring.release();
+    assert_equal((void*)NULL, (void*)ring.front());
+  }
+  
+  void test_full_ring_drops( void ) {
+    ValueRing ring(2);
+    Inlet *inlet = (Inlet*)&ring;
+    assert_true(ring.push(inlet, Value(1.0)));
+    assert_true(ring.push(inlet, Value(2.0)));
+    assert_false(ring.push(inlet, Value(3.0)));
+    assert_equal(1, (int)ring.dropped());
+    ring.release();
+    assert_true(ring.push(inlet, Value(4.0)));
+    assert_equal(2.0, ring.front()->value_.r);
+  }
+};
@@ -29,6 +29,48 @@
 
 #include "test_helper.h"
 
+/** Node taking some time in each bang (to consume the loop budget). */
+class SlowNode : public DummyNode
+{
+public:
+  SlowNode() : DummyNode(0.0) {}
+
+  virtual void bang(const Value &val) {
+    long long start = WorkerStats::now_us();
+    while (WorkerStats::now_us() - start < 20)
+      ;
+    DummyNode::bang(val);
+  }
+};
+
+/** Node counting the frames it processes in block ticks. */
+class BlockNode : public DummyNode
+{
+public:
+  BlockNode() : DummyNode(0.0), ticks_(0) {}
+
+  virtual void process_block(size_t frames) {
+    value_ += frames;
+    ++ticks_;
+  }
+
+  size_t ticks_;
+};
+
+/** Node registering a new forced event each time it is banged. */
+class ReforcingNode : public DummyNode
+{
+public:
+  ReforcingNode(Worker *worker) : DummyNode(0.0), worker_(worker) {}
+
+  virtual void bang(const Value &val) {
+    DummyNode::bang(val);
+    worker_->register_event(new BangEvent(this, worker_->current_time_ + 10, true));
+  }
+
+  Worker *worker_;
+};
+
 class WorkerTest : public TestHelper
 {
 public:
@@ -51,4 +93,203 @@ public:
     assert_true(start + 8  <= worker.current_time_);
     assert_true(start + 12 >= worker.current_time_);
   }
+  
+  void test_deadline_mode( void ) {
+    Root   root;
+    Worker worker(&root);
+    DummyNode node(0.0);
+    worker.set_deadline_mode(true);
+    
+    worker.start(); // running in new thread
+    long long start = Profiler::now_ns();
+    worker.lock();
+      worker.register_event(new BangEvent(&node, worker.now() + 20));
+    worker.unlock();
+    // generous timeout: only the lower bound depends on the scheduler
+    for (int i = 0; i < 100 && node.value_ == 0.0; ++i) microsleep(10);
+    long long elapsed_ms = (Profiler::now_ns() - start) / 1000000;
+    worker.kill();
+    assert_equal(1.0, node.value_);
+    // never before the deadline (times are truncated to [ms])
+    assert_true(elapsed_ms >= 19);
+  }
+  
+  void test_deadline_wakes_on_time( void ) {
+    Root   root;
+    Worker worker(&root);
+    DummyNode node(0.0);
+    worker.set_deadline_mode(true);
+    worker.stats()->set_enabled(true);
+    
+    worker.start(); // running in new thread
+    worker.lock();
+      worker.register_event(new BangEvent(&node, worker.now() + 5));
+    worker.unlock();
+    for (int i = 0; i < 100 && node.value_ == 0.0; ++i) microsleep(10);
+    worker.kill();
+    assert_equal(1.0, node.value_);
+    // woken up by the event and not by the WORKER_MAX_IDLE_MS timeout (lateness < 32 [ms])
+    Value lateness = worker.stats()->lateness();
+    Real on_time = 0;
+    for (size_t i = 0; i < 6; ++i) on_time += lateness[i].r;
+    assert_equal(1.0, on_time);
+  }
+  
+  void test_deadline_sleeps_without_call_limit( void ) {
+    Root   root;
+    Worker worker(&root);
+    worker.set_max_calls_per_loop(0); // no limit
+    worker.set_deadline_mode(true);
+    worker.should_run(true);
+    worker.loop(); // polling loop
+    worker.loop(); // consumes the pending wake up
+    
+    long long start = Profiler::now_ns();
+    worker.loop(); // nothing to do: sleeps WORKER_MAX_IDLE_MS
+    assert_true((Profiler::now_ns() - start) / 1000000 >= WORKER_MAX_IDLE_MS - 10);
+  }
+  
+  void test_now_outside_loop( void ) {
+    Root   root;
+    Worker worker(&root);
+    DummyNode node(0.0);
+    worker.should_run(true);
+    worker.loop();
+    time_t start = worker.current_time_;
+    microsleep(30);
+    // a command registering an event does not use the time of the last loop
+    assert_true(worker.now() >= start + 29);
+    // too late: dropped instead of being triggered on next loop
+    worker.register_event(new BangEvent(&node, start + 10));
+    worker.loop();
+    assert_equal(0.0, node.value_);
+  }
+
+  void test_free_events_with_reforcing_node( void ) {
+    Root   root;
+    Worker worker(&root);
+    ReforcingNode node(&worker);
+    worker.register_event(new BangEvent(&node, worker.current_time_ + 10, true));
+    
+    // forced event fires once, its re-registration is dropped
+    worker.free_events_for(&node);
+    assert_equal(1.0, node.value_);
+    worker.free_events_for(&node);
+    assert_equal(1.0, node.value_);
+  }
+  
+  void test_stats( void ) {
+    Root   root;
+    Worker worker(&root);
+    DummyNode node(0.0);
+    Value lateness;
+    node.set_context(&worker); // reserves the node's statistics slot
+    worker.stats()->set_enabled(true);
+    worker.should_run(true);
+    
+    worker.register_event(new BangEvent(&node, worker.current_time_ + 5));
+    while (node.value_ == 0.0) worker.loop();
+    assert_equal(1, (int)worker.stats()->calls(&node));
+    
+    lateness = worker.stats()->lateness();
+    assert_equal(WORKER_STATS_LATENESS_BUCKETS, (int)lateness.size());
+    Real count = 0;
+    for (size_t i = 0; i < lateness.size(); ++i) count += lateness[i].r;
+    assert_equal(1.0, count);
+    
+    worker.stats()->reset();
+    assert_equal(0.0, worker.stats()->lateness()[0].r);
+    assert_equal(0, (int)worker.stats()->calls(&node));
+  }
+  
+  void test_looped_nodes( void ) {
+    Root   root;
+    Worker worker(&root);
+    DummyNode a(0.0), b(0.0), c(0.0);
+    worker.should_run(true);
+    
+    worker.register_looped_node(&a);
+    worker.register_looped_node(&b);
+    worker.register_looped_node(&c);
+    worker.register_looped_node(&c); // ignored
+    worker.free_looped_node(&b);     // c takes b's place
+    assert_true(a.is_looped());
+    assert_false(b.is_looped());
+    assert_true(c.is_looped());
+    
+    worker.loop();
+    assert_equal(1.0, a.value_);
+    assert_equal(0.0, b.value_);
+    assert_equal(1.0, c.value_);
+    
+    a.set_loop_divisor(2);
+    worker.loop();
+    worker.loop();
+    assert_equal(2.0, a.value_);
+    assert_equal(3.0, c.value_);
+    
+    worker.free_looped_node(&a);
+    worker.free_looped_node(&c);
+    assert_false(c.is_looped());
+  }
+  
+  void test_loop_budget( void ) {
+    Root   root;
+    Worker worker(&root);
+    SlowNode high, a, b, c;
+    worker.should_run(true);
+    worker.set_loop_budget(1);
+    
+    high.set_loop_priority(LOOP_PRIORITY_HIGH);
+    worker.register_looped_node(&a);
+    worker.register_looped_node(&b);
+    worker.register_looped_node(&c);
+    worker.register_looped_node(&high);
+    
+    // every class bangs at least one node and the others wait their turn
+    worker.loop();
+    assert_equal(1.0, high.value_);
+    assert_equal(1.0, a.value_);
+    assert_equal(0.0, b.value_);
+    worker.loop();
+    worker.loop();
+    assert_equal(3.0, high.value_);
+    assert_equal(1.0, a.value_);
+    assert_equal(1.0, b.value_);
+    assert_equal(1.0, c.value_);
+    assert_equal(3, (int)worker.stats()->deferred_loops());
+    assert_equal(6, (int)worker.stats()->deferred_nodes());
+    
+    // no budget: bang everything
+    worker.set_loop_budget(0);
+    worker.loop();
+    assert_equal(2.0, a.value_);
+    assert_equal(2.0, b.value_);
+    assert_equal(2.0, c.value_);
+    assert_equal(3, (int)worker.stats()->deferred_loops());
+    
+    worker.free_looped_node(&high);
+    worker.free_looped_node(&a);
+    worker.free_looped_node(&b);
+    worker.free_looped_node(&c);
+  }
+  
+  void test_block_ticks( void ) {
+    Root   root;
+    Worker worker(&root);
+    BlockNode node;
+    worker.should_run(true);
+    worker.set_block_size(4);
+    worker.set_block_rate(1000); // one tick every 4 [ms]
+    worker.register_block_node(&node);
+    assert_true(node.is_block_node());
+    
+    while (worker.current_time_ < 18) worker.loop();
+    // ticks at 0, 4, 8, 12, 16 (and 20 if the last loop was slow)
+    assert_true(node.ticks_ >= 5 && node.ticks_ <= 6);
+    assert_equal(node.ticks_ * 4.0, node.value_);
+    
+    worker.free_block_node(&node);
+    assert_false(node.is_block_node());
+  }
 };